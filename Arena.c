@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "Arena.h"
+
+//All allocations are aligned to this boundary
+#define ARENA_ALIGN 16
+#define ALIGN_UP(n) (((n) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+#define CHUNK_HEADER ALIGN_UP(sizeof(ArenaChunk))
+
+static ArenaChunk *newChunk(size_t size) {
+	ArenaChunk *chunk = malloc(CHUNK_HEADER + size);
+
+	assert(chunk != NULL);
+
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+
+	return chunk;
+}
+
+Arena *newArena(size_t chunkSize) {
+	Arena *arena = malloc(sizeof(Arena));
+
+	assert(arena != NULL);
+
+	arena->chunkSize = ALIGN_UP(chunkSize);
+	arena->first = newChunk(arena->chunkSize);
+	arena->current = arena->first;
+	arena->bytesAllocated = arena->chunkSize;
+
+	return arena;
+}
+
+void deleteArena(Arena *arena) {
+	ArenaChunk *chunk = arena->first;
+
+	while (chunk != NULL) {
+		ArenaChunk *next = chunk->next;
+
+		free(chunk);
+		chunk = next;
+	}
+
+	free(arena);
+}
+
+void *arenaAlloc(Arena *arena, size_t size) {
+	size = ALIGN_UP(size);
+
+	ArenaChunk *chunk = arena->current;
+
+	if (chunk->used + size > chunk->size) {
+		//Reuse the next chunk if it is big enough. Otherwise
+		//insert a new chunk after the current one.
+		if (chunk->next != NULL && chunk->next->size >= size) {
+			chunk = chunk->next;
+		} else {
+			size_t chunkSize = size > arena->chunkSize ?
+				size : arena->chunkSize;
+			ArenaChunk *fresh = newChunk(chunkSize);
+
+			fresh->next = chunk->next;
+			chunk->next = fresh;
+			chunk = fresh;
+			arena->bytesAllocated += chunkSize;
+		}
+		chunk->used = 0;
+		arena->current = chunk;
+	}
+
+	void *ptr = (char*) chunk + CHUNK_HEADER + chunk->used;
+
+	chunk->used += size;
+
+	return ptr;
+}
+
+void *arenaCalloc(Arena *arena, size_t size) {
+	void *ptr = arenaAlloc(arena, size);
+
+	memset(ptr, 0, size);
+
+	return ptr;
+}
+
+/*
+ * Makes all memory in the arena available again. The chunks are
+ * kept for reuse, so this does not touch any of the memory.
+ */
+void arenaReset(Arena *arena) {
+	arena->current = arena->first;
+	arena->first->used = 0;
+}
+
+ArenaMark arenaMark(Arena *arena) {
+	ArenaMark mark;
+
+	mark.chunk = arena->current;
+	mark.used = arena->current->used;
+
+	return mark;
+}
+
+/*
+ * Gives back everything allocated since the mark was taken.
+ */
+void arenaRelease(Arena *arena, ArenaMark mark) {
+	arena->current = mark.chunk;
+	arena->current->used = mark.used;
+}
@@ -0,0 +1,32 @@
+#include <stddef.h>
+
+/*
+ * A simple bump allocator. Memory is handed out from large chunks
+ * and is only given back all at once by arenaReset() or, for the
+ * most recent allocations, by arenaRelease().
+ */
+typedef struct _ArenaChunk {
+	struct _ArenaChunk *next;
+	size_t size;
+	size_t used;
+} ArenaChunk;
+
+typedef struct _Arena {
+	ArenaChunk *first;
+	ArenaChunk *current;
+	size_t chunkSize;
+	size_t bytesAllocated;
+} Arena;
+
+typedef struct _ArenaMark {
+	ArenaChunk *chunk;
+	size_t used;
+} ArenaMark;
+
+Arena *newArena(size_t chunkSize);
+void deleteArena(Arena *arena);
+void *arenaAlloc(Arena *arena, size_t size);
+void *arenaCalloc(Arena *arena, size_t size);
+void arenaReset(Arena *arena);
+ArenaMark arenaMark(Arena *arena);
+void arenaRelease(Arena *arena, ArenaMark mark);
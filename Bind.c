@@ -0,0 +1,350 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include "Parser.h"
+
+/*
+ * Binding reads the document with the pull tokenizer and writes each
+ * value straight into the struct. Recursion only follows the nesting
+ * of the schema. Values that are not in the schema are skipped by
+ * counting brackets, however deep they are.
+ */
+
+static bool fail(JSONParser *parser, ErrorCode code, const char *msg) {
+	if (parser->errorCode == ERROR_NONE) {
+		parser->errorCode = code;
+		parser->errorMessage = msg;
+		jsonCountErrorLines(parser);
+	}
+
+	return false;
+}
+
+static bool mismatch(JSONParser *parser) {
+	return fail(parser, ERROR_INVALID_TYPE, "Value does not match the type of field.");
+}
+
+static size_t itemSize(const JSONField *field) {
+	switch (field->itemType) {
+	case JSON_FIELD_DOUBLE:
+		return sizeof(double);
+	case JSON_FIELD_INT:
+		return sizeof(int);
+	case JSON_FIELD_INT64:
+		return sizeof(int64_t);
+	case JSON_FIELD_UINT64:
+		return sizeof(uint64_t);
+	case JSON_FIELD_BOOL:
+		return sizeof(bool);
+	case JSON_FIELD_STRING:
+		return sizeof(String*);
+	case JSON_FIELD_OBJECT:
+		assert(field->schema != NULL);
+
+		return field->schema->size;
+	default:
+		assert(false);
+
+		return 0;
+	}
+}
+
+//An array item is bound as an unnamed field at offset 0
+static JSONField itemField(const JSONField *field) {
+	JSONField item = {NULL, field->itemType, 0, 0, field->schema, 0, 0};
+
+	return item;
+}
+
+static void freeField(const JSONField *field, char *base) {
+	char *p = base + field->offset;
+
+	if (field->type == JSON_FIELD_STRING) {
+		String **s = (String**) p;
+
+		if (*s != NULL) {
+			deleteString(*s);
+			*s = NULL;
+		}
+	} else if (field->type == JSON_FIELD_OBJECT) {
+		jsonFreeBinding(field->schema, p);
+	} else if (field->type == JSON_FIELD_ARRAY) {
+		int *count = (int*) (base + field->countOffset);
+		char *items = field->size > 0 ? p : *(char**) p;
+		JSONField item = itemField(field);
+		size_t size = itemSize(field);
+
+		for (int i = 0; i < *count; ++i) {
+			freeField(&item, items + i * size);
+		}
+		if (field->size == 0) {
+			free(items);
+			*(char**) p = NULL;
+		}
+
+		*count = 0;
+	}
+}
+
+void jsonFreeBinding(const JSONSchema *schema, void *out) {
+	for (int i = 0; i < schema->fieldCount; ++i) {
+		freeField(schema->fields + i, out);
+	}
+}
+
+/*
+ * Finds the field for a property name. Properties usually come in the
+ * order of the fields, so the search starts after the last match.
+ */
+static const JSONField *
+findField(const JSONSchema *schema, const char *name, size_t length, int *next) {
+	for (int n = 0; n < schema->fieldCount; ++n) {
+		int i = (*next + n) % schema->fieldCount;
+		const JSONField *f = schema->fields + i;
+
+		if (strlen(f->name) == length && memcmp(f->name, name, length) == 0) {
+			*next = i + 1;
+
+			return f;
+		}
+	}
+
+	return NULL;
+}
+
+//Skips the value that starts with token
+static bool skipValue(JSONParser *parser, JSONToken *token) {
+	int depth = 0;
+
+	do {
+		if (token->type == JSON_TOKEN_START_OBJECT ||
+			token->type == JSON_TOKEN_START_ARRAY) {
+			++depth;
+		} else if (token->type == JSON_TOKEN_END_OBJECT ||
+			token->type == JSON_TOKEN_END_ARRAY) {
+			--depth;
+		} else if (token->type == JSON_TOKEN_ERROR) {
+			return false;
+		}
+	} while (depth > 0 && jsonNextToken(parser, token) != JSON_TOKEN_ERROR);
+
+	return depth == 0;
+}
+
+static bool bindValue(JSONParser *parser, const JSONField *field, char *base, JSONToken *token);
+
+//Binds the members of an object after its '{'
+static bool bindObject(JSONParser *parser, const JSONSchema *schema, char *base) {
+	JSONToken token;
+	int next = 0;
+
+	while (jsonNextToken(parser, &token) == JSON_TOKEN_KEY) {
+		//The key is only valid until the next token
+		const JSONField *f = findField(schema, token.string, token.length, &next);
+
+		if (jsonNextToken(parser, &token) == JSON_TOKEN_ERROR) {
+			return false;
+		}
+		if (f == NULL) {
+			if (!skipValue(parser, &token)) {
+				return false;
+			}
+		} else if (!bindValue(parser, f, base, &token)) {
+			return false;
+		}
+	}
+
+	return token.type == JSON_TOKEN_END_OBJECT;
+}
+
+//Binds the items of an array after its '['
+static bool bindArray(JSONParser *parser, const JSONField *field, char *base) {
+	char *p = base + field->offset;
+	int *count = (int*) (base + field->countOffset);
+	JSONField item = itemField(field);
+	size_t size = itemSize(field);
+	int capacity = (int) field->size;
+	JSONToken token;
+
+	//A repeated property replaces the earlier items
+	freeField(field, base);
+
+	while (jsonNextToken(parser, &token) > JSON_TOKEN_END &&
+		token.type != JSON_TOKEN_END_ARRAY) {
+		if (*count == capacity) {
+			if (field->size > 0) {
+				return fail(parser, ERROR_INVALID_TYPE, "Too many items for field.");
+			}
+
+			capacity = capacity == 0 ? 8 : capacity * 2;
+			*(char**) p = realloc(*(char**) p, capacity * size);
+
+			assert(*(char**) p != NULL);
+		}
+
+		char *items = field->size > 0 ? p : *(char**) p;
+		char *itemBase = items + *count * size;
+
+		//Null items are left zeroed
+		memset(itemBase, 0, size);
+		*count += 1;
+
+		if (!bindValue(parser, &item, itemBase, &token)) {
+			return false;
+		}
+	}
+
+	return token.type == JSON_TOKEN_END_ARRAY;
+}
+
+static bool bindString(JSONParser *parser, char *p, const JSONField *field, JSONToken *token) {
+	if (field->type == JSON_FIELD_CHARS) {
+		if (token->length >= field->size) {
+			return fail(parser, ERROR_INVALID_TYPE, "String too long for field.");
+		}
+
+		memcpy(p, token->string, token->length);
+		p[token->length] = '\0';
+
+		return true;
+	}
+
+	String **s = (String**) p;
+
+	if (*s == NULL) {
+		*s = newStringWithCapacity(token->length);
+	} else {
+		(*s)->length = 0;
+	}
+
+	stringAppendBuffer(*s, token->string, token->length);
+
+	return true;
+}
+
+static bool bindInteger(JSONParser *parser, char *p, JSONFieldType type, JSONToken *token) {
+	if (token->type != JSON_TOKEN_INTEGER) {
+		return mismatch(parser);
+	}
+
+	bool isUnsigned = token->flags & JSON_FLAG_UNSIGNED;
+	int64_t i = token->value.integer;
+
+	if (type == JSON_FIELD_UINT64) {
+		if (!isUnsigned && i < 0) {
+			return fail(parser, ERROR_INVALID_TYPE, "Integer out of range for field.");
+		}
+
+		*(uint64_t*) p = token->value.unsignedInteger;
+	} else if (isUnsigned ||
+		(type == JSON_FIELD_INT && (i < INT_MIN || i > INT_MAX))) {
+		return fail(parser, ERROR_INVALID_TYPE, "Integer out of range for field.");
+	} else if (type == JSON_FIELD_INT) {
+		*(int*) p = (int) i;
+	} else {
+		*(int64_t*) p = i;
+	}
+
+	return true;
+}
+
+static bool bindValue(JSONParser *parser, const JSONField *field, char *base, JSONToken *token) {
+	char *p = base + field->offset;
+
+	if (token->type == JSON_TOKEN_NULL) {
+		return true;
+	}
+
+	switch (field->type) {
+	case JSON_FIELD_DOUBLE:
+		if (token->type == JSON_TOKEN_NUMBER) {
+			*(double*) p = token->value.number;
+		} else if (token->type == JSON_TOKEN_INTEGER) {
+			*(double*) p = token->flags & JSON_FLAG_UNSIGNED ?
+				(double) token->value.unsignedInteger :
+				(double) token->value.integer;
+		} else {
+			return mismatch(parser);
+		}
+
+		return true;
+	case JSON_FIELD_INT:
+	case JSON_FIELD_INT64:
+	case JSON_FIELD_UINT64:
+		return bindInteger(parser, p, field->type, token);
+	case JSON_FIELD_BOOL:
+		if (token->type != JSON_TOKEN_BOOLEAN) {
+			return mismatch(parser);
+		}
+
+		*(bool*) p = token->value.booleanValue;
+
+		return true;
+	case JSON_FIELD_STRING:
+	case JSON_FIELD_CHARS:
+		if (token->type != JSON_TOKEN_STRING) {
+			return mismatch(parser);
+		}
+
+		return bindString(parser, p, field, token);
+	case JSON_FIELD_OBJECT:
+		if (token->type != JSON_TOKEN_START_OBJECT) {
+			return mismatch(parser);
+		}
+
+		return bindObject(parser, field->schema, p);
+	case JSON_FIELD_ARRAY:
+		if (token->type != JSON_TOKEN_START_ARRAY) {
+			return mismatch(parser);
+		}
+
+		return bindArray(parser, field, base);
+	}
+
+	return mismatch(parser);
+}
+
+//Binds the document after jsonBeginTokens() or jsonBeginTokenStream()
+static bool bindRoot(JSONParser *parser, const JSONSchema *schema, void *out) {
+	bool parseIntegers = parser->parseIntegers;
+	JSONToken token;
+	bool ok = false;
+
+	//Integer fields need the exact value
+	parser->parseIntegers = true;
+
+	if (jsonNextToken(parser, &token) == JSON_TOKEN_START_OBJECT) {
+		ok = bindObject(parser, schema, out);
+	} else if (token.type != JSON_TOKEN_ERROR) {
+		fail(parser, ERROR_SYNTAX, "Document does not start with '{'.");
+	}
+
+	parser->parseIntegers = parseIntegers;
+
+	return ok && parser->errorCode == ERROR_NONE;
+}
+
+bool jsonBind(JSONParser *parser, String *stringToParse,
+	const JSONSchema *schema, void *out) {
+	jsonBeginTokens(parser, stringToParse);
+
+	return bindRoot(parser, schema, out);
+}
+
+bool jsonBindCString(JSONParser *parser, const char *stringToParse,
+	const JSONSchema *schema, void *out) {
+	String *str = newStringWithCString(stringToParse);
+	bool ok = jsonBind(parser, str, schema, out);
+
+	deleteString(str);
+
+	return ok;
+}
+
+bool jsonBindStream(JSONParser *parser, int streamFd,
+	const JSONSchema *schema, void *out) {
+	jsonBeginTokenStream(parser, streamFd);
+
+	return bindRoot(parser, schema, out);
+}
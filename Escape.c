@@ -0,0 +1,171 @@
+#include "Escape.h"
+
+/*
+ * Code stolen from: http://stackoverflow.com/a/4609989/1036017
+ * A surrogate can not be written as UTF-8 and becomes U+FFFD.
+ */
+void unicodeToUTF8(int unicode, char *out, int *bytesWritten) {
+	char *pos = out;
+
+	if (unicode-0xd800u<0x800) unicode=0xfffd;
+
+	if (unicode<0x80) *pos++=unicode;
+	else if (unicode<0x800) *pos++=192+unicode/64, *pos++=128+unicode%64;
+	else if (unicode<0x10000) *pos++=224+unicode/4096, *pos++=128+unicode/64%64, *pos++=128+unicode%64;
+	else if (unicode<0x110000) *pos++=240+unicode/262144, *pos++=128+unicode/4096%64, *pos++=128+unicode/64%64, *pos++=128+unicode%64;
+
+
+	*bytesWritten = (pos - out);
+}
+
+//Value of every hex digit, -1 for other characters
+static const signed char hexDigits[256] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+int hexValue(const char *in) {
+	int a = hexDigits[(unsigned char) in[0]];
+	int b = hexDigits[(unsigned char) in[1]];
+	int c = hexDigits[(unsigned char) in[2]];
+	int d = hexDigits[(unsigned char) in[3]];
+
+	if ((a | b | c | d) < 0) {
+		return -1;
+	}
+
+	return a << 12 | b << 8 | c << 4 | d;
+}
+
+int decodeEscape(int unit, int *high, char *out) {
+	int bytesWritten;
+
+	if (unit >= 0xDC00 && unit <= 0xDFFF && *high != 0) {
+		//Replace the U+FFFD written for the high surrogate
+		unicodeToUTF8(0x10000 + ((*high - 0xD800) << 10) + (unit - 0xDC00),
+			out - 3, &bytesWritten);
+		*high = 0;
+
+		return bytesWritten - 3;
+	}
+
+	*high = unit >= 0xD800 && unit <= 0xDBFF ? unit : 0;
+	unicodeToUTF8(unit, out, &bytesWritten);
+
+	return bytesWritten;
+}
+
+/*
+ * Decodes the escape sequences of a string that has already been
+ * validated by the parser. The output is never longer than the input.
+ * Returns the number of bytes written.
+ */
+size_t unescapeString(const char *in, size_t length, char *out) {
+	const char *end = in + length;
+	char *pos = out;
+	int high = 0;
+
+	while (in < end) {
+		char ch = *in++;
+
+		if (ch != '\\') {
+			*pos++ = ch;
+			high = 0;
+			continue;
+		}
+
+		char escaped = *in++;
+
+		if (escaped == 'u') {
+			pos += decodeEscape(hexValue(in), &high, pos);
+			in += 4;
+			continue;
+		}
+
+		high = 0;
+
+		if (escaped == 't') {
+			*pos++ = '\t';
+		} else if (escaped == 'r') {
+			*pos++ = '\r';
+		} else if (escaped == 'n') {
+			*pos++ = '\n';
+		} else if (escaped == 'b') {
+			*pos++ = '\b';
+		} else if (escaped == 'f') {
+			*pos++ = '\f';
+		} else {
+			*pos++ = escaped;
+		}
+	}
+
+	return pos - out;
+}
+
+//True for the characters that may follow '\' other than 'u'
+static bool isSimpleEscape(char ch) {
+	switch (ch) {
+	case '"': case '\\': case '/':
+	case 'b': case 'f': case 'n': case 'r': case 't':
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Finds the closing quote of a string that starts right after the
+ * opening quote, checking the escape sequences on the way. Sets
+ * *escaped if there are any. On error, sets *error to a message and
+ * returns where the problem was found.
+ */
+const char *findStringEnd(const char *start, const char *end,
+	bool *escaped, const char **error) {
+	const char *pos = start;
+
+	*escaped = false;
+	*error = NULL;
+
+	while (pos < end && *pos != '"') {
+		if (*pos == '\\') {
+			*escaped = true;
+			++pos;
+
+			if (pos >= end) {
+				break;
+			}
+			if (*pos == 'u') {
+				if (end - pos <= 4 || hexValue(pos + 1) < 0) {
+					*error = "Invalid escaped character in string.";
+					return pos;
+				}
+				pos += 4;
+			} else if (!isSimpleEscape(*pos)) {
+				*error = "Invalid escaped character in string.";
+				return pos;
+			}
+		}
+		++pos;
+	}
+
+	if (pos >= end) {
+		*error = "Premature end of document while parsing string.";
+		return end;
+	}
+
+	return pos;
+}
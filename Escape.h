@@ -0,0 +1,15 @@
+#include <stddef.h>
+#include <stdbool.h>
+
+void unicodeToUTF8(int unicode, char *out, int *bytesWritten);
+int hexValue(const char *in);
+/*
+ * Writes the UTF-8 of the code unit of a \u escape to out and returns
+ * how far out moves. A high surrogate is written as U+FFFD and kept in
+ * *high. When the next escape is its low surrogate, the pair replaces
+ * those 3 bytes before out. Reset *high to 0 after anything else.
+ */
+int decodeEscape(int unit, int *high, char *out);
+size_t unescapeString(const char *in, size_t length, char *out);
+const char *findStringEnd(const char *start, const char *end,
+	bool *escaped, const char **error);
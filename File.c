@@ -0,0 +1,41 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "File.h"
+
+const char *mapFile(const char *path, size_t *length, int *fd) {
+	struct stat st;
+
+	*length = 0;
+	*fd = open(path, O_RDONLY);
+
+	if (*fd < 0) {
+		return NULL;
+	}
+	if (fstat(*fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+		return NULL;
+	}
+
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, *fd, 0);
+
+	if (data == MAP_FAILED) {
+		return NULL;
+	}
+
+	//The parser reads the file front to back once
+	posix_madvise(data, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+	close(*fd);
+	*fd = -1;
+	*length = st.st_size;
+
+	return data;
+}
+
+void unmapFile(const char *data, size_t length) {
+	munmap((void*) data, length);
+}
@@ -0,0 +1,10 @@
+#include <stddef.h>
+
+/*
+ * Maps a whole file for sequential reading. If the file can not be
+ * mapped, for example a pipe, NULL is returned and *fd is left open
+ * so that the file can be read instead. *fd is -1 if the file could
+ * not be opened.
+ */
+const char *mapFile(const char *path, size_t *length, int *fd);
+void unmapFile(const char *data, size_t length);
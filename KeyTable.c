@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "Parser.h"
+#include "Arena.h"
+#include "KeyTable.h"
+
+//Names and keys are allocated from chunks of this size
+#define KEY_CHUNK_SIZE (16 * 1024)
+#define INITIAL_SLOTS 256
+
+KeyTable *newKeyTable() {
+	KeyTable *table = malloc(sizeof(KeyTable));
+
+	assert(table != NULL);
+
+	table->capacity = INITIAL_SLOTS;
+	table->count = 0;
+	table->slots = calloc(table->capacity, sizeof(JSONKey*));
+	table->arena = newArena(KEY_CHUNK_SIZE);
+
+	assert(table->slots != NULL);
+
+	return table;
+}
+
+void deleteKeyTable(KeyTable *table) {
+	deleteArena(table->arena);
+	free(table->slots);
+	free(table);
+}
+
+static void grow(KeyTable *table) {
+	size_t capacity = table->capacity * 2;
+	size_t mask = capacity - 1;
+	JSONKey **slots = calloc(capacity, sizeof(JSONKey*));
+
+	assert(slots != NULL);
+
+	for (size_t i = 0; i < table->capacity; ++i) {
+		JSONKey *key = table->slots[i];
+
+		if (key != NULL) {
+			size_t slot = key->hash & mask;
+
+			while (slots[slot] != NULL) {
+				slot = (slot + 1) & mask;
+			}
+			slots[slot] = key;
+		}
+	}
+
+	free(table->slots);
+	table->slots = slots;
+	table->capacity = capacity;
+}
+
+/*
+ * Returns the interned key for a name, adding it if this is the
+ * first time the name is seen. The hash must be the one used for
+ * object members.
+ */
+const JSONKey *internKey(KeyTable *table, const char *name,
+	size_t length, unsigned int hash) {
+	size_t mask = table->capacity - 1;
+	size_t slot = hash & mask;
+
+	for (JSONKey *key; (key = table->slots[slot]) != NULL;
+		slot = (slot + 1) & mask) {
+		if (key->hash == hash && key->length == length &&
+			memcmp(key->name, name, length) == 0) {
+			return key;
+		}
+	}
+
+	//Keep the table at most half full
+	if ((table->count + 1) * 2 > table->capacity) {
+		grow(table);
+
+		mask = table->capacity - 1;
+		slot = hash & mask;
+
+		while (table->slots[slot] != NULL) {
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	JSONKey *key = arenaAlloc(table->arena, sizeof(JSONKey) + length + 1);
+	char *chars = (char*) (key + 1);
+
+	memcpy(chars, name, length);
+	chars[length] = '\0';
+
+	key->name = chars;
+	key->length = length;
+	key->hash = hash;
+
+	table->slots[slot] = key;
+	table->count += 1;
+
+	return key;
+}
@@ -0,0 +1,18 @@
+#include <stddef.h>
+
+/*
+ * Set of interned property names owned by a parser. Names are
+ * never removed, so the JSONKey pointers stay valid until the
+ * table is deleted.
+ */
+typedef struct _KeyTable {
+	JSONKey **slots;
+	size_t capacity;
+	size_t count;
+	struct _Arena *arena;
+} KeyTable;
+
+KeyTable *newKeyTable();
+void deleteKeyTable(KeyTable *table);
+const JSONKey *internKey(KeyTable *table, const char *name,
+	size_t length, unsigned int hash);
@@ -0,0 +1,499 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include "Parser.h"
+
+//Most records handed to a worker at a time
+#define BATCH_RECORDS 256
+//Default number of bytes read from a stream at a time
+#define LINES_BLOCK_SIZE (1024 * 1024)
+
+/*
+ * A block of data read from a stream. It is shared by all the
+ * batches cut from it and freed by the last one.
+ */
+typedef struct _LinesBlock {
+	char *data;
+	int references;
+} LinesBlock;
+
+//Records to be parsed by one worker
+typedef struct _LinesBatch {
+	const char *data;
+	size_t length;
+	//Line number of the first record
+	size_t line;
+	size_t sequence;
+	LinesBlock *block;
+	struct _LinesBatch *next;
+} LinesBatch;
+
+typedef struct _LinesRun {
+	JSONLinesParser *lines;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	LinesBatch *head;
+	LinesBatch *tail;
+	int queued;
+	int maxQueued;
+	bool done;
+	size_t nextSequence; //Batch that may deliver next in ordered mode
+	size_t submitted;
+	size_t line;
+} LinesRun;
+
+typedef struct _LinesWorker {
+	LinesRun *run;
+	pthread_t thread;
+	//One parser per record of a batch in ordered mode
+	JSONParser **parsers;
+	int parserCount;
+	size_t records;
+	size_t errors;
+} LinesWorker;
+
+JSONLinesParser *newJSONLinesParser() {
+	JSONLinesParser *lines = malloc(sizeof(JSONLinesParser));
+
+	assert(lines != NULL);
+
+	lines->threads = 0;
+	lines->ordered = false;
+	lines->blockSize = LINES_BLOCK_SIZE;
+	lines->onNewParser = NULL;
+	lines->onRecord = NULL;
+	lines->context = NULL;
+	lines->recordCount = 0;
+	lines->errorCount = 0;
+	lines->errorCode = ERROR_NONE;
+
+	return lines;
+}
+
+void deleteJSONLinesParser(JSONLinesParser *lines) {
+	free(lines);
+}
+
+static JSONParser *workerParser(LinesWorker *worker, int index) {
+	if (index < worker->parserCount) {
+		return worker->parsers[index];
+	}
+
+	JSONLinesParser *lines = worker->run->lines;
+
+	worker->parsers = realloc(worker->parsers,
+		(index + 1) * sizeof(JSONParser*));
+
+	assert(worker->parsers != NULL);
+
+	JSONParser *parser = newJSONParser();
+
+	if (lines->onNewParser != NULL) {
+		lines->onNewParser(parser, lines->context);
+	}
+
+	worker->parsers[index] = parser;
+	worker->parserCount = index + 1;
+
+	return parser;
+}
+
+static bool isBlank(const char *s, size_t length) {
+	for (size_t i = 0; i < length; ++i) {
+		if (s[i] != ' ' && s[i] != '\t' && s[i] != '\r') {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void deliver(LinesWorker *worker, JSONParser *parser, size_t line) {
+	JSONLinesParser *lines = worker->run->lines;
+	bool failed = parser->errorCode != ERROR_NONE;
+
+	worker->records += 1;
+	worker->errors += failed ? 1 : 0;
+
+	if (lines->onRecord != NULL) {
+		lines->onRecord(parser, failed ? NULL : parser->root,
+			line, lines->context);
+	}
+}
+
+static void releaseBatch(LinesRun *run, LinesBatch *batch) {
+	if (batch->block != NULL) {
+		pthread_mutex_lock(&run->lock);
+
+		bool last = --batch->block->references == 0;
+
+		pthread_mutex_unlock(&run->lock);
+
+		if (last) {
+			free(batch->block->data);
+			free(batch->block);
+		}
+	}
+
+	free(batch);
+}
+
+/*
+ * Parses every record of a batch. In ordered mode all records are
+ * parsed first, each by its own parser, and delivered once every
+ * earlier batch has been delivered.
+ */
+static void parseBatch(LinesWorker *worker, LinesBatch *batch) {
+	LinesRun *run = worker->run;
+	bool ordered = run->lines->ordered;
+	const char *p = batch->data;
+	const char *end = batch->data + batch->length;
+	size_t line = batch->line;
+	size_t lineNumbers[BATCH_RECORDS];
+	int count = 0;
+
+	while (p < end) {
+		const char *newLine = memchr(p, '\n', end - p);
+		const char *lineEnd = newLine != NULL ? newLine : end;
+		size_t length = lineEnd - p;
+
+		if (!isBlank(p, length)) {
+			JSONParser *parser = workerParser(worker, ordered ? count : 0);
+			String record;
+
+			record.buffer = (char*) p;
+			record.length = length;
+			record.capacity = length;
+
+			jsonParse(parser, &record);
+
+			if (ordered) {
+				lineNumbers[count++] = line;
+			} else {
+				deliver(worker, parser, line);
+			}
+		}
+
+		p = lineEnd + 1;
+		++line;
+	}
+
+	if (ordered) {
+		pthread_mutex_lock(&run->lock);
+
+		while (run->nextSequence != batch->sequence) {
+			pthread_cond_wait(&run->changed, &run->lock);
+		}
+
+		pthread_mutex_unlock(&run->lock);
+
+		for (int i = 0; i < count; ++i) {
+			deliver(worker, worker->parsers[i], lineNumbers[i]);
+		}
+
+		pthread_mutex_lock(&run->lock);
+		run->nextSequence += 1;
+		pthread_cond_broadcast(&run->changed);
+		pthread_mutex_unlock(&run->lock);
+	}
+}
+
+static void *work(void *arg) {
+	LinesWorker *worker = arg;
+	LinesRun *run = worker->run;
+
+	while (1) {
+		pthread_mutex_lock(&run->lock);
+
+		while (run->head == NULL && !run->done) {
+			pthread_cond_wait(&run->changed, &run->lock);
+		}
+
+		LinesBatch *batch = run->head;
+
+		if (batch != NULL) {
+			run->head = batch->next;
+
+			if (run->head == NULL) {
+				run->tail = NULL;
+			}
+
+			run->queued -= 1;
+			pthread_cond_broadcast(&run->changed);
+		}
+
+		pthread_mutex_unlock(&run->lock);
+
+		if (batch == NULL) {
+			break;
+		}
+
+		parseBatch(worker, batch);
+		releaseBatch(run, batch);
+	}
+
+	return NULL;
+}
+
+static void enqueue(LinesRun *run, LinesBatch *batch) {
+	pthread_mutex_lock(&run->lock);
+
+	while (run->queued >= run->maxQueued) {
+		pthread_cond_wait(&run->changed, &run->lock);
+	}
+
+	batch->next = NULL;
+
+	if (run->tail != NULL) {
+		run->tail->next = batch;
+	} else {
+		run->head = batch;
+	}
+
+	run->tail = batch;
+	run->queued += 1;
+
+	pthread_cond_broadcast(&run->changed);
+	pthread_mutex_unlock(&run->lock);
+}
+
+/*
+ * Cuts data into batches of at most BATCH_RECORDS lines. The data
+ * must end at the end of a line. Line numbers continue from the
+ * previous call.
+ */
+static void submit(LinesRun *run, const char *data, size_t length, LinesBlock *block) {
+	const char *p = data;
+	const char *end = data + length;
+
+	while (p < end) {
+		LinesBatch *batch = malloc(sizeof(LinesBatch));
+
+		assert(batch != NULL);
+
+		batch->data = p;
+		batch->line = run->line;
+		batch->sequence = run->submitted++;
+		batch->block = block;
+
+		for (int i = 0; i < BATCH_RECORDS && p < end; ++i) {
+			const char *newLine = memchr(p, '\n', end - p);
+
+			p = newLine != NULL ? newLine + 1 : end;
+			run->line += 1;
+		}
+
+		batch->length = p - batch->data;
+
+		if (block != NULL) {
+			pthread_mutex_lock(&run->lock);
+			block->references += 1;
+			pthread_mutex_unlock(&run->lock);
+		}
+
+		enqueue(run, batch);
+	}
+}
+
+static int workerCount(JSONLinesParser *lines) {
+	if (lines->threads > 0) {
+		return lines->threads;
+	}
+
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return cpus > 0 ? (int) cpus : 1;
+}
+
+typedef void (*Producer)(LinesRun *run, void *source);
+
+/*
+ * Starts the workers, lets the producer submit all the data and
+ * waits for every record to be delivered.
+ */
+static bool runLines(JSONLinesParser *lines, Producer produce, void *source) {
+	LinesRun run;
+	int count = workerCount(lines);
+	LinesWorker *workers = calloc(count, sizeof(LinesWorker));
+
+	assert(workers != NULL);
+
+	pthread_mutex_init(&run.lock, NULL);
+	pthread_cond_init(&run.changed, NULL);
+	run.lines = lines;
+	run.head = NULL;
+	run.tail = NULL;
+	run.queued = 0;
+	run.maxQueued = 2 * count;
+	run.done = false;
+	run.nextSequence = 0;
+	run.submitted = 0;
+	run.line = 1;
+
+	lines->recordCount = 0;
+	lines->errorCount = 0;
+	lines->errorCode = ERROR_NONE;
+
+	for (int i = 0; i < count; ++i) {
+		workers[i].run = &run;
+
+		int status = pthread_create(&workers[i].thread, NULL, work, workers + i);
+
+		assert(status == 0);
+	}
+
+	produce(&run, source);
+
+	pthread_mutex_lock(&run.lock);
+	run.done = true;
+	pthread_cond_broadcast(&run.changed);
+	pthread_mutex_unlock(&run.lock);
+
+	for (int i = 0; i < count; ++i) {
+		pthread_join(workers[i].thread, NULL);
+
+		lines->recordCount += workers[i].records;
+		lines->errorCount += workers[i].errors;
+
+		for (int j = 0; j < workers[i].parserCount; ++j) {
+			deleteJSONParser(workers[i].parsers[j]);
+		}
+		free(workers[i].parsers);
+	}
+
+	free(workers);
+	pthread_cond_destroy(&run.changed);
+	pthread_mutex_destroy(&run.lock);
+
+	return lines->errorCode == ERROR_NONE;
+}
+
+static void produceFromString(LinesRun *run, void *source) {
+	String *data = source;
+
+	submit(run, data->buffer, data->length, NULL);
+}
+
+/*
+ * Reads the stream in blocks. The partial line at the end of a block
+ * is carried over to the next block.
+ */
+static void produceFromStream(LinesRun *run, void *source) {
+	int fd = *(int*) source;
+	size_t blockSize = run->lines->blockSize > 0 ?
+		run->lines->blockSize : LINES_BLOCK_SIZE;
+	LinesBlock *block = NULL;
+	size_t capacity = 0;
+	size_t length = 0;
+	bool eof = false;
+
+	while (!eof) {
+		if (block == NULL) {
+			block = malloc(sizeof(LinesBlock));
+
+			assert(block != NULL);
+
+			block->data = malloc(blockSize);
+			block->references = 1;
+			capacity = blockSize;
+
+			assert(block->data != NULL);
+		} else if (length == capacity) {
+			//A line longer than the block
+			capacity *= 2;
+			block->data = realloc(block->data, capacity);
+
+			assert(block->data != NULL);
+		}
+
+		ssize_t sz = read(fd, block->data + length, capacity - length);
+
+		if (sz < 0 && errno == EINTR) {
+			continue;
+		}
+		if (sz < 0) {
+			run->lines->errorCode = ERROR_IO;
+		}
+		if (sz <= 0) {
+			eof = true;
+		} else {
+			length += sz;
+		}
+
+		const char *last = NULL;
+
+		if (eof) {
+			last = block->data + length;
+		} else if (length == capacity) {
+			//Hand over whole lines only
+			for (size_t i = length; i > 0; --i) {
+				if (block->data[i - 1] == '\n') {
+					last = block->data + i;
+					break;
+				}
+			}
+		}
+
+		if (last == NULL) {
+			continue;
+		}
+
+		size_t used = last - block->data;
+		LinesBlock *next = NULL;
+
+		if (used < length) {
+			next = malloc(sizeof(LinesBlock));
+
+			assert(next != NULL);
+
+			next->references = 1;
+			next->data = malloc(blockSize > length - used ?
+				blockSize : 2 * (length - used));
+
+			assert(next->data != NULL);
+
+			memcpy(next->data, last, length - used);
+		}
+
+		submit(run, block->data, used, block);
+
+		//Drop the reference held while reading
+		pthread_mutex_lock(&run->lock);
+
+		bool unused = --block->references == 0;
+
+		pthread_mutex_unlock(&run->lock);
+
+		if (unused) {
+			free(block->data);
+			free(block);
+		}
+
+		length -= used;
+		block = next;
+
+		if (next != NULL) {
+			capacity = blockSize > length ? blockSize : 2 * length;
+		}
+	}
+
+	if (block != NULL) {
+		free(block->data);
+		free(block);
+	}
+}
+
+/*
+ * Parses every line of data as a separate document on a pool of
+ * worker threads. Returns false on a read error.
+ */
+bool jsonParseLines(JSONLinesParser *lines, String *data) {
+	return runLines(lines, produceFromString, data);
+}
+
+bool jsonParseLinesStream(JSONLinesParser *lines, int fd) {
+	return runLines(lines, produceFromStream, &fd);
+}
@@ -0,0 +1,275 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <float.h>
+#include <locale.h>
+#include <assert.h>
+#include "Number.h"
+
+//Longer numbers are copied to the heap for strtod
+#define MAX_NUMBER_LENGTH 1024
+
+static const double powersOf10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static bool isDigit(char ch) {
+	return ch >= '0' && ch <= '9';
+}
+
+/*
+ * Correctly rounded conversion for the cases the fast path can not
+ * handle. strtod uses the decimal point of the current locale, so
+ * the number is copied with the '.' replaced.
+ */
+static double slowConvert(const char *s, size_t length) {
+	char stackBuffer[MAX_NUMBER_LENGTH + 1];
+	char *buffer = stackBuffer;
+	const char *point = localeconv()->decimal_point;
+
+	if (length > MAX_NUMBER_LENGTH) {
+		buffer = malloc(length + 1);
+
+		assert(buffer != NULL);
+	}
+
+	memcpy(buffer, s, length);
+	buffer[length] = '\0';
+
+	if (point[0] != '.' && point[0] != '\0' && point[1] == '\0') {
+		char *dot = memchr(buffer, '.', length);
+
+		if (dot != NULL) {
+			*dot = point[0];
+		}
+	}
+
+	double d = strtod(buffer, NULL);
+
+	if (buffer != stackBuffer) {
+		free(buffer);
+	}
+
+	return d;
+}
+
+size_t scanNumber(const char *s, const char *end, Number *out) {
+	const char *p = s;
+	bool negative = false;
+	uint64_t mantissa = 0;
+	int digits = 0; //Significant digits in mantissa
+	bool truncated = false;
+	int exponent = 0;
+	bool isInteger = true;
+
+	if (p < end && *p == '-') {
+		negative = true;
+		++p;
+	}
+	if (p >= end || !isDigit(*p)) {
+		return 0;
+	}
+
+	//Integer part. No leading zeros.
+	if (*p == '0') {
+		++p;
+	} else {
+		while (p < end && isDigit(*p)) {
+			int d = *p - '0';
+
+			//The 20th digit still fits if it does not overflow
+			if (digits < 19 || (digits == 19 &&
+				mantissa <= (UINT64_MAX - d) / 10)) {
+				mantissa = mantissa * 10 + d;
+				++digits;
+			} else {
+				truncated = true;
+				++exponent;
+			}
+			++p;
+		}
+	}
+
+	//Fraction
+	if (p < end && *p == '.') {
+		isInteger = false;
+		++p;
+
+		if (p >= end || !isDigit(*p)) {
+			return 0;
+		}
+		while (p < end && isDigit(*p)) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) {
+					++digits;
+				}
+				--exponent;
+			} else if (*p != '0') {
+				truncated = true;
+			}
+			++p;
+		}
+	}
+
+	//Exponent
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		bool negativeExponent = false;
+		int e = 0;
+
+		isInteger = false;
+		++p;
+
+		if (p < end && (*p == '+' || *p == '-')) {
+			negativeExponent = *p == '-';
+			++p;
+		}
+		if (p >= end || !isDigit(*p)) {
+			return 0;
+		}
+		while (p < end && isDigit(*p)) {
+			if (e < 100000) {
+				e = e * 10 + (*p - '0');
+			}
+			++p;
+		}
+		exponent += negativeExponent ? -e : e;
+	}
+
+	size_t length = p - s;
+
+	//Integer fast path
+	if (isInteger && !truncated) {
+		if (negative) {
+			if (mantissa <= (uint64_t) INT64_MAX + 1) {
+				out->kind = NUMBER_INTEGER;
+				out->value.i = mantissa == (uint64_t) INT64_MAX + 1 ?
+					INT64_MIN : -(int64_t) mantissa;
+
+				return length;
+			}
+		} else if (mantissa <= INT64_MAX) {
+			out->kind = NUMBER_INTEGER;
+			out->value.i = (int64_t) mantissa;
+
+			return length;
+		} else {
+			out->kind = NUMBER_UNSIGNED;
+			out->value.u = mantissa;
+
+			return length;
+		}
+	}
+
+	out->kind = NUMBER_DOUBLE;
+
+	//Clinger's fast path. Both the mantissa and the power of 10 are
+	//exact doubles, so a single multiply or divide rounds correctly.
+#if FLT_EVAL_METHOD == 0
+	if (!truncated && mantissa <= (1ULL << 53)) {
+		double d = (double) mantissa;
+
+		if (mantissa == 0) {
+			out->value.d = negative ? -0.0 : 0.0;
+
+			return length;
+		}
+		if (exponent >= 0 && exponent <= 22) {
+			d *= powersOf10[exponent];
+		} else if (exponent < 0 && exponent >= -22) {
+			d /= powersOf10[-exponent];
+		} else if (exponent > 22 && exponent <= 22 + 15 &&
+			mantissa <= (1ULL << 53) / (uint64_t) powersOf10[exponent - 22]) {
+			//Move some of the exponent into the mantissa
+			d = (double) (mantissa * (uint64_t) powersOf10[exponent - 22]) *
+				powersOf10[22];
+		} else {
+			goto slow;
+		}
+
+		out->value.d = negative ? -d : d;
+
+		return length;
+	}
+slow:
+#endif
+	out->value.d = slowConvert(s, length);
+
+	return length;
+}
+
+size_t formatUnsigned(uint64_t u, char *out) {
+	char digits[20];
+	size_t count = 0;
+
+	do {
+		digits[count++] = '0' + u % 10;
+		u /= 10;
+	} while (u != 0);
+
+	for (size_t i = 0; i < count; ++i) {
+		out[i] = digits[count - 1 - i];
+	}
+
+	return count;
+}
+
+size_t formatInteger(int64_t i, char *out) {
+	if (i < 0) {
+		out[0] = '-';
+
+		//Negate as unsigned to handle INT64_MIN
+		return 1 + formatUnsigned(-(uint64_t) i, out + 1);
+	}
+
+	return formatUnsigned(i, out);
+}
+
+/*
+ * Writes the fewest significant digits that read back exactly, trying
+ * 15, 16 and 17. A double that can be written with 15 digits or fewer
+ * is always the nearest 15 digit decimal to it, and %g drops trailing
+ * zeros, so that text is the shortest. A subnormal has fewer bits, so
+ * every precision from 1 up is tried for it. The one exception is a
+ * power of 2 needing 16 digits, whose nearest 16 digit decimal may be
+ * just outside its narrower lower half: it gets 17 digits.
+ */
+size_t formatDouble(double d, char *out) {
+	if (isnan(d) || isinf(d)) {
+		return 0;
+	}
+	if (d == 0.0) {
+		memcpy(out, signbit(d) ? "-0" : "0", 2);
+
+		return signbit(d) ? 2 : 1;
+	}
+	if (d > -9007199254740992.0 && d < 9007199254740992.0 &&
+		d == (double) (int64_t) d) {
+		//Integral values are written without the exponent
+		return formatInteger((int64_t) d, out);
+	}
+
+	char buffer[MAX_FORMATTED_NUMBER];
+	int length = 0;
+
+	int precision = fabs(d) < DBL_MIN ? 1 : 15;
+
+	for (; precision <= 17; ++precision) {
+		length = snprintf(buffer, sizeof(buffer), "%.*g", precision, d);
+
+		if (precision == 17 || strtod(buffer, NULL) == d) {
+			break;
+		}
+	}
+
+	//Undo the decimal point of the current locale
+	const char *point = localeconv()->decimal_point;
+
+	for (int i = 0; i < length; ++i) {
+		out[i] = buffer[i] == point[0] ? '.' : buffer[i];
+	}
+
+	return length;
+}
@@ -0,0 +1,38 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum _NumberKind {
+	NUMBER_DOUBLE,
+	NUMBER_INTEGER, //Fits in int64_t
+	NUMBER_UNSIGNED //Positive, fits in uint64_t but not in int64_t
+} NumberKind;
+
+typedef struct _Number {
+	NumberKind kind;
+	union {
+		double d;
+		int64_t i;
+		uint64_t u;
+	} value;
+} Number;
+
+/*
+ * Scans a JSON number at the start of the buffer. Returns the number of
+ * characters consumed, or 0 if the buffer does not start with a valid
+ * JSON number.
+ */
+size_t scanNumber(const char *s, const char *end, Number *out);
+
+//Longest text written by the format functions, without a NULL
+#define MAX_FORMATTED_NUMBER 32
+
+/*
+ * Write a number as JSON text and return the number of characters
+ * written. The output is not NULL terminated. formatDouble() writes the
+ * fewest digits that read back as the same double, and returns 0 for
+ * NaN and infinity which JSON can not represent.
+ */
+size_t formatInteger(int64_t i, char *out);
+size_t formatUnsigned(uint64_t u, char *out);
+size_t formatDouble(double d, char *out);
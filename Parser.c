@@ -4,33 +4,31 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
+#include <pthread.h>
 #include "Parser.h"
+#include "Arena.h"
+#include "Number.h"
+#include "Escape.h"
+#include "Utf8.h"
+#include "KeyTable.h"
+#include "File.h"
+#include "Stats.h"
 
 #define FAIL(cond, p, code, msg) if (cond) {save_error(p, code, msg); return NULL;}
 
-static int printDict(const char *key, void *value) {
-	printf("Key: \"%s\"\n", key);
-	jsonPrintObject((JSONObject*) value);
-
-	return 1;
-}
+static const char *stringValueChars(JSONObject *o, size_t *length);
+static const char *cStringValue(JSONObject *o);
 
 void
 jsonPrintObject(JSONObject *o) {
-	switch (o->type) {
-		case JSON_STRING:
-			puts("Printing String...");
-			printf("\"%s\"\n", 
-				stringAsCString(o->value.string));
-			break;
-		case JSON_OBJECT:
-			puts("Printing object...");
-			dictionaryIterate(o->value.object,
-				printDict);
-			break;
-		default:
-			printf("Unsupported type.");
-	}
+	JSONWriter *writer = newJSONWriter();
+
+	writer->pretty = true;
+	jsonWrite(writer, o);
+	fwrite(writer->buffer, 1, writer->length, stdout);
+
+	deleteJSONWriter(writer);
 }
 
 JSONParser *newJSONParser() {
@@ -42,63 +40,289 @@ JSONParser *newJSONParser() {
 	parser->root = NULL;
 	parser->position = 0;
 	parser->errorLine = 0;
+	parser->lineOffset = 0;
 	parser->errorCode = ERROR_NONE;
 	parser->errorMessage = NULL;
 	parser->onPropertyParsed = NULL;
 	parser->onValueParsed = NULL;
 	parser->streamFd = -1;
-	parser->putbackBuffer = newString();
+	parser->mappedData = NULL;
+	parser->cStringData = NULL;
+	parser->streamBufferSize = JSON_STREAM_BUFFER_SIZE;
+	parser->streamBuffer = NULL;
+	parser->streamBufferCapacity = 0;
+	parser->streamBufferLength = 0;
+	parser->streamBufferPosition = 0;
 	parser->lastReadChar = '\0';
+	parser->arenaChunkSize = 0;
+	parser->arena = NULL;
+	parser->zeroCopyStrings = false;
+	parser->parseIntegers = false;
+	parser->validateUTF8 = false;
+	parser->internKeys = false;
+	parser->keys = NULL;
+	parser->threads = 1;
+	parser->workers = NULL;
+	parser->workerCount = 0;
+	parser->projection = NULL;
+	parser->projectionLength = 0;
+	parser->selected = NULL;
+	parser->selectedLength = 0;
+	parser->selectedCapacity = 0;
+	parser->selectedFirst = 0;
+	parser->selectedCount = -1;
+	parser->selectedDepth = 0;
+	parser->lazy = false;
+	parser->spans = NULL;
+	parser->spanLength = 0;
+	parser->spanCapacity = 0;
+	parser->spanNext = 0;
+	parser->inPlace = false;
+	parser->inPlaceData = NULL;
+	parser->pending = NULL;
+	parser->pendingLength = 0;
+	parser->pendingCapacity = 0;
+	parser->textLength = 0;
+	parser->textCapacity = 256;
+	parser->tape = NULL;
+	parser->binary = NULL;
+	parser->tokenStack = NULL;
+	parser->tokenDepth = 0;
+	parser->tokenStackCapacity = 0;
+	parser->tokenState = 0;
+	parser->maxDepth = JSON_MAX_DEPTH;
+	parser->frames = NULL;
+	parser->frameDepth = 0;
+	parser->frameCapacity = 0;
+	parser->clearStack = NULL;
+	parser->clearStackCapacity = 0;
+	parser->feedState = 0;
+	parser->feedConsumed = 0;
+	parser->text = malloc(parser->textCapacity);
+
+	assert(parser->text != NULL);
+
+	parser->propertyName = newString();
 
 	return parser;
 }
 
-static void deleteJSONObject(JSONObject *o);
+static void deleteTree(JSONParser *parser, JSONObject *o);
+static void unwindFeed(JSONParser *parser);
 
 void clearParser(JSONParser *parser) {
+	//Attach the values of an unfinished push parse to the root
+	unwindFeed(parser);
+
 	if (parser->root != NULL) {
-		deleteJSONObject(parser->root);
+		if ((parser->root->flags & JSON_FLAG_ARENA) == 0) {
+			deleteTree(parser, parser->root);
+		}
 		parser->root = NULL;
 	}
+	if (parser->arena != NULL) {
+		arenaReset(parser->arena);
+	}
+	if (parser->mappedData != NULL && parser->mappedData->buffer != NULL) {
+		unmapFile(parser->mappedData->buffer, parser->mappedData->length);
+		parser->mappedData->buffer = NULL;
+	}
+	if (parser->cStringData != NULL) {
+		deleteString(parser->cStringData);
+		parser->cStringData = NULL;
+	}
+	//Items of a parallel parse were moved to the root above
+	for (int i = 0; i < parser->workerCount; ++i) {
+		clearParser(parser->workers[i]);
+	}
 
 	parser->data = NULL;
 	parser->position = 0;
 	parser->errorLine = 0;
+	parser->lineOffset = 0;
 	parser->errorCode = ERROR_NONE;
 	parser->errorMessage = NULL;
 	parser->streamFd = -1;
-	parser->putbackBuffer->length = 0;
+	parser->streamBufferLength = 0;
+	parser->streamBufferPosition = 0;
 	parser->lastReadChar = '\0';
-}
-
-static int delete_object_properties(const char *key, void *value) {
-	deleteJSONObject((JSONObject*) value);
+	parser->pendingLength = 0;
+	parser->textLength = 0;
+	parser->lazy = false;
+	parser->spanLength = 0;
+	parser->spanNext = 0;
+	parser->inPlace = false;
+	parser->tokenDepth = 0;
+	parser->tokenState = 0;
+	parser->feedState = 0;
+	parser->feedHigh = 0;
+	STAT_RESET(parser);
+	parser->feedConsumed = 0;
+	parser->utf8State = UTF8_ACCEPT;
+
+	if (parser->internKeys && parser->keys == NULL) {
+		parser->keys = newKeyTable();
+	}
 
-	return 1;
+	//Switch between heap and arena allocation
+	if (parser->arenaChunkSize > 0) {
+		if (parser->arena != NULL &&
+			parser->arena->chunkSize < parser->arenaChunkSize) {
+			deleteArena(parser->arena);
+			parser->arena = NULL;
+		}
+		if (parser->arena == NULL) {
+			parser->arena = newArena(parser->arenaChunkSize);
+		}
+	} else if (parser->arena != NULL) {
+		deleteArena(parser->arena);
+		parser->arena = NULL;
+	}
 }
 
-void jsonClear(JSONObject *o) {
-	if (o->type == JSON_STRING) {
+//A container being freed by clearTree()
+typedef struct _ClearFrame {
+	JSONObject *node;
+	size_t next;
+} ClearFrame;
+
+//Frames of clearTree() kept on the C stack
+#define CLEAR_STACK_SIZE 32
+
+//Frees what a node owns, except for its children
+static void clearNode(JSONObject *o) {
+	if (o->flags & JSON_FLAG_LAZY) {
+		//Nothing has been built
+		o->flags &= ~JSON_FLAG_LAZY;
+	} else if (o->flags & JSON_FLAG_IN_PLACE) {
+		//The characters belong to the caller's buffer
+	} else if (o->type == JSON_STRING && (o->flags & JSON_FLAG_VIEW)) {
+		if (o->value.view->string != NULL) {
+			deleteString(o->value.view->string);
+		}
+		free(o->value.view);
+	} else if (o->type == JSON_STRING) {
 		deleteString(o->value.string);
-		o->value.string = NULL;
 	} else if (o->type == JSON_ARRAY) {
-		for (int i = 0; i < o->value.array->length; ++i) {
-			JSONObject *item = arrayGet(o->value.array, i);
-			deleteJSONObject(item);
-		}
-		deleteArray(o->value.array);
-		o->value.array = NULL;
+		free(o->value.array.items);
 	} else if (o->type == JSON_OBJECT) {
-		dictionaryIterate(o->value.object, delete_object_properties);
-		deleteDictionary(o->value.object);
-		o->value.object = NULL;
+		//Names and hash index share the same block
+		free(o->value.object.members);
 	}
 
+	memset(&o->value, 0, sizeof(o->value));
 	o->type = JSON_UNDEFINED;
 }
 
-static void deleteJSONObject(JSONObject *o) {
-	jsonClear(o);
+static JSONObject *childAt(JSONObject *o, size_t index) {
+	if (o->flags & JSON_FLAG_LAZY) {
+		return NULL;
+	}
+	if (o->type == JSON_ARRAY) {
+		return index < o->value.array.length ?
+			o->value.array.items[index] : NULL;
+	}
+
+	return index < o->value.object.length ?
+		o->value.object.members[index].value : NULL;
+}
+
+/*
+ * Frees everything below o without recursion. The containers being
+ * freed are kept in *stack, which is grown as needed. If heap is false
+ * *stack is an array of the caller and is copied to the heap instead
+ * of reallocated.
+ */
+static void clearTree(JSONObject *o, ClearFrame **stack, size_t *capacity,
+	bool heap) {
+	size_t depth = 0;
+
+	(*stack)[depth].node = o;
+	(*stack)[depth++].next = 0;
+
+	while (depth > 0) {
+		ClearFrame *f = *stack + depth - 1;
+		JSONObject *child = childAt(f->node, f->next++);
+
+		if (child == NULL) {
+			//All children are freed
+			clearNode(f->node);
+
+			if (--depth > 0) {
+				free(f->node);
+			}
+
+			continue;
+		}
+
+		if ((child->type != JSON_ARRAY && child->type != JSON_OBJECT) ||
+			(child->flags & JSON_FLAG_ARENA)) {
+			jsonClear(child);
+			free(child);
+
+			continue;
+		}
+
+		if (depth == *capacity) {
+			*capacity *= 2;
+
+			if (!heap) {
+				ClearFrame *grown = malloc(*capacity * sizeof(ClearFrame));
+
+				assert(grown != NULL);
+
+				memcpy(grown, *stack, depth * sizeof(ClearFrame));
+				*stack = grown;
+				heap = true;
+			} else {
+				*stack = realloc(*stack, *capacity * sizeof(ClearFrame));
+
+				assert(*stack != NULL);
+			}
+		}
+
+		(*stack)[depth].node = child;
+		(*stack)[depth++].next = 0;
+	}
+}
+
+void jsonClear(JSONObject *o) {
+	if (o->flags & JSON_FLAG_ARENA) {
+		//Memory is given back to the arena by the parser
+		memset(&o->value, 0, sizeof(o->value));
+		o->type = JSON_UNDEFINED;
+		o->flags &= ~JSON_FLAG_LAZY;
+
+		return;
+	}
+
+	if (o->type != JSON_ARRAY && o->type != JSON_OBJECT) {
+		clearNode(o);
+
+		return;
+	}
+
+	ClearFrame local[CLEAR_STACK_SIZE];
+	ClearFrame *stack = local;
+	size_t capacity = CLEAR_STACK_SIZE;
+
+	clearTree(o, &stack, &capacity, false);
+
+	if (stack != local) {
+		free(stack);
+	}
+}
+
+//Deletes a document using the parser's stack
+static void deleteTree(JSONParser *parser, JSONObject *o) {
+	if (parser->clearStack == NULL) {
+		parser->clearStackCapacity = CLEAR_STACK_SIZE;
+		parser->clearStack = malloc(CLEAR_STACK_SIZE * sizeof(ClearFrame));
+
+		assert(parser->clearStack != NULL);
+	}
+
+	clearTree(o, &parser->clearStack, &parser->clearStackCapacity, true);
 
 	free(o);
 }
@@ -106,68 +330,332 @@ static void deleteJSONObject(JSONObject *o) {
 void deleteJSONParser(JSONParser *parser) {
 	clearParser(parser);
 
-	deleteString(parser->putbackBuffer);
+	free(parser->streamBuffer);
+	free(parser->pending);
+	free(parser->text);
+	free(parser->tokenStack);
+	free(parser->frames);
+	free(parser->spans);
+	free(parser->clearStack);
+	free(parser->selected);
+	deleteString(parser->propertyName);
+
+	if (parser->tape != NULL) {
+		deleteJSONTape(parser->tape);
+	}
+	if (parser->binary != NULL) {
+		deleteJSONTape(parser->binary);
+	}
+	if (parser->keys != NULL) {
+		deleteKeyTable(parser->keys);
+	}
+	for (int i = 0; i < parser->workerCount; ++i) {
+		deleteJSONParser(parser->workers[i]);
+	}
+	free(parser->workers);
+	free(parser->mappedData);
+	free(parser->inPlaceData);
+
+	if (parser->arena != NULL) {
+		deleteArena(parser->arena);
+	}
 
 	free(parser);
 }
 
 static void onPropertyParsed(JSONParser *parser, String *name, JSONObject *val) {
-	if (parser->onPropertyParsed != NULL) {
+	if (parser->onPropertyParsed != NULL && !parser->lazy) {
 		parser->onPropertyParsed(parser, name, val);
 	}
 }
 
 static void onValueParsed(JSONParser *parser, JSONObject *val) {
-	if (parser->onValueParsed != NULL) {
+	if (parser->onValueParsed != NULL && !parser->lazy) {
 		parser->onValueParsed(parser, val);
 	}
 }
 
+/*
+ * In arena mode, if a callback has cleared a value with jsonClear(),
+ * give back the memory of everything below the value's node.
+ */
+static void releaseIfCleared(JSONParser *parser, JSONObject *val, ArenaMark mark) {
+	if (parser->arena != NULL && val->type == JSON_UNDEFINED) {
+		arenaRelease(parser->arena, mark);
+	}
+}
+
+//Number of line breaks before position
+static size_t countLines(const char *data, size_t position) {
+	size_t line = 0;
+
+	for (size_t i = 0; i < position; ++i) {
+		if (data[i] == '\n') {
+			++line;
+		}
+	}
+
+	return line;
+}
+
+void jsonCountErrorLines(JSONParser *parser) {
+	if (parser->streamFd >= 0 || parser->data == NULL) {
+		//A stream counts lines as it reads them
+		return;
+	}
+
+	//In memory, lines are not counted while parsing
+	assert(parser->position >= parser->lineOffset);
+
+	parser->errorLine += countLines(parser->data->buffer + parser->lineOffset,
+		parser->position - parser->lineOffset);
+	parser->lineOffset = parser->position;
+}
+
 void save_error(JSONParser *p, ErrorCode code, const char *msg) {
+	//Keep the first error, later ones are usually caused by it
+	if (p->errorCode != ERROR_NONE) {
+		return;
+	}
+
 	p->errorCode = code;
 	p->errorMessage = msg;
+	jsonCountErrorLines(p);
+}
+
+/*
+ * FNV-1a hash of a property name.
+ */
+static unsigned int hashName(const char *name, size_t length) {
+	unsigned int h = 2166136261u;
+
+	for (size_t i = 0; i < length; ++i) {
+		h ^= (unsigned char) name[i];
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+/*
+ * Objects with fewer members than this are searched linearly
+ * and carry no hash index.
+ */
+#define MEMBER_INDEX_MIN 8
+
+/*
+ * Number of hash index slots for an object with the given
+ * number of members. Always a power of 2 at least twice as big,
+ * or 0 for a small object.
+ */
+static size_t indexSlots(size_t length) {
+	if (length < MEMBER_INDEX_MIN) {
+		return 0;
+	}
+
+	size_t slots = 16;
+
+	while (slots < length * 2) {
+		slots <<= 1;
+	}
+
+	return slots;
+}
+
+/*
+ * The hash index follows the member array. Each slot holds
+ * a member index plus one, zero marks an empty slot.
+ */
+static unsigned int *memberIndex(JSONMember *members, size_t length) {
+	return (unsigned int*) (members + length);
+}
+
+//Builds a container of a lazy parse before it is read
+#define EXPAND(o) if ((o)->flags & JSON_FLAG_LAZY) jsonExpand(o)
+
+static JSONObject *
+findMember(JSONObject *o, const char *name, size_t length, unsigned int hash) {
+	EXPAND(o);
+
+	size_t count = o->value.object.length;
+
+	if (count == 0) {
+		return NULL;
+	}
+
+	JSONMember *members = o->value.object.members;
+
+	if (count < MEMBER_INDEX_MIN) {
+		//Search from the end so a repeated name finds the last one
+		for (JSONMember *m = members + count - 1; m >= members; --m) {
+			if (m->hash == hash && (m->name == name ||
+				(m->nameLength == length &&
+				memcmp(m->name, name, length) == 0))) {
+				return m->value;
+			}
+		}
+
+		return NULL;
+	}
+
+	unsigned int *index = memberIndex(members, count);
+	size_t mask = indexSlots(count) - 1;
+
+	for (size_t slot = hash & mask; index[slot] != 0; slot = (slot + 1) & mask) {
+		JSONMember *m = members + index[slot] - 1;
+
+		//Interned names can be compared by pointer
+		if (m->hash == hash && (m->name == name ||
+			(m->nameLength == length &&
+			memcmp(m->name, name, length) == 0))) {
+			return m->value;
+		}
+	}
+
+	return NULL;
+}
+
+static JSONObject *
+getMember(JSONObject *o, const char *name) {
+	assert(o->type == JSON_OBJECT);
+
+	size_t length = strlen(name);
+
+	return findMember(o, name, length, hashName(name, length));
+}
+
+/*
+ * Numbers can be read as double or integer regardless of how
+ * they were stored.
+ */
+static double numberValue(JSONObject *o) {
+	if (o->type == JSON_INTEGER) {
+		return o->flags & JSON_FLAG_UNSIGNED ?
+			(double) o->value.unsignedInteger :
+			(double) o->value.integer;
+	}
+
+	assert(o->type == JSON_NUMBER);
+
+	return o->value.number;
+}
+
+static int64_t integerValue(JSONObject *o) {
+	if (o->type == JSON_NUMBER) {
+		return (int64_t) o->value.number;
+	}
+
+	assert(o->type == JSON_INTEGER);
+	assert((o->flags & JSON_FLAG_UNSIGNED) == 0);
+
+	return o->value.integer;
+}
+
+static uint64_t unsignedValue(JSONObject *o) {
+	if (o->type == JSON_NUMBER) {
+		return (uint64_t) o->value.number;
+	}
+
+	assert(o->type == JSON_INTEGER);
+	assert(o->value.integer >= 0 || (o->flags & JSON_FLAG_UNSIGNED));
+
+	return o->value.unsignedInteger;
 }
 
 static JSONObject *
-getArrayObject(JSONObject *o, int index) {
+getArrayObject(JSONObject *o, size_t index) {
 	assert(o->type == JSON_ARRAY);
+	EXPAND(o);
+	assert(index < o->value.array.length);
 
-	return arrayGet(o->value.array, index);
+	return o->value.array.items[index];
 }
 
-int jsonGetArrayLength(JSONObject *a) {
+size_t jsonGetArrayLength(JSONObject *a) {
 	assert(a->type == JSON_ARRAY);
+	EXPAND(a);
+
+	return a->value.array.length;
+}
 
-	return a->value.array->length;
+size_t jsonGetMemberCount(JSONObject *o) {
+	assert(o->type == JSON_OBJECT);
+	EXPAND(o);
+
+	return o->value.object.length;
+}
+
+const char *jsonGetMemberName(JSONObject *o, size_t index, size_t *length) {
+	assert(o->type == JSON_OBJECT);
+	EXPAND(o);
+	assert(index < o->value.object.length);
+
+	JSONMember *m = o->value.object.members + index;
+
+	if (length != NULL) {
+		*length = m->nameLength;
+	}
+
+	return m->name;
+}
+
+JSONObject *jsonGetMemberValue(JSONObject *o, size_t index) {
+	assert(o->type == JSON_OBJECT);
+	EXPAND(o);
+	assert(index < o->value.object.length);
+
+	return o->value.object.members[index].value;
 }
 
-String *jsonGetStringAt(JSONObject *a, int index) {
+String *jsonGetStringAt(JSONObject *a, size_t index) {
 	JSONObject *child = getArrayObject(a, index);
 	
 	if (child == NULL) {
 		return NULL; //Not found
 	}
-	assert(child->type == JSON_STRING);
 
-	return child->value.string;
+	return jsonGetStringValue(child);
+}
+
+const char *jsonGetCStringAt(JSONObject *a, size_t index) {
+	return cStringValue(getArrayObject(a, index));
 }
 
-const char *jsonGetCStringAt(JSONObject *a, int index) {
-	return stringAsCString(jsonGetStringAt(a, index));
+const char *jsonGetStringViewAt(JSONObject *a, size_t index, size_t *length) {
+	return stringValueChars(getArrayObject(a, index), length);
 }
 
-double jsonGetNumberAt(JSONObject *a, int index) {
+double jsonGetNumberAt(JSONObject *a, size_t index) {
 	JSONObject *child = getArrayObject(a, index);
 	
 	if (child == NULL) {
 		return 0.0; //Not found
 	}
-	assert(child->type == JSON_NUMBER);
 
-	return child->value.number;
+	return numberValue(child);
+}
+
+int64_t jsonGetIntegerAt(JSONObject *a, size_t index) {
+	JSONObject *child = getArrayObject(a, index);
+	
+	if (child == NULL) {
+		return 0; //Not found
+	}
+
+	return integerValue(child);
+}
+
+uint64_t jsonGetUnsignedAt(JSONObject *a, size_t index) {
+	JSONObject *child = getArrayObject(a, index);
+	
+	if (child == NULL) {
+		return 0; //Not found
+	}
+
+	return unsignedValue(child);
 }
 
-JSONObject *jsonGetObjectAt(JSONObject *a, int index) {
+JSONObject *jsonGetObjectAt(JSONObject *a, size_t index) {
 	JSONObject *child = getArrayObject(a, index);
 	
 	if (child == NULL) {
@@ -179,7 +667,7 @@ JSONObject *jsonGetObjectAt(JSONObject *a, int index) {
 	return child;
 }
 
-JSONObject *jsonGetArrayAt(JSONObject *a, int index) {
+JSONObject *jsonGetArrayAt(JSONObject *a, size_t index) {
 	JSONObject *child = getArrayObject(a, index);
 	
 	if (child == NULL) {
@@ -191,7 +679,7 @@ JSONObject *jsonGetArrayAt(JSONObject *a, int index) {
 	return child;
 }
 
-bool jsonGetBooleanAt(JSONObject *a, int index) {
+bool jsonGetBooleanAt(JSONObject *a, size_t index) {
 	JSONObject *child = getArrayObject(a, index);
 	
 	if (child == NULL) {
@@ -203,7 +691,7 @@ bool jsonGetBooleanAt(JSONObject *a, int index) {
 	return child->value.booleanValue;
 }
 
-bool jsonIsNullAt(JSONObject *a, int index) {
+bool jsonIsNullAt(JSONObject *a, size_t index) {
 	JSONObject *child = getArrayObject(a, index);
 	
 	if (child == NULL) {
@@ -218,40 +706,63 @@ bool jsonIsNullAt(JSONObject *a, int index) {
 }
 
 String *jsonGetString(JSONObject *o, const char *name) {
-	assert(o->type == JSON_OBJECT);
-
-	JSONObject *child = dictionaryGet(o->value.object, name);
+	JSONObject *child = getMember(o, name);
 	
 	if (child == NULL) {
 		return NULL; //Not found
 	}
-	assert(child->type == JSON_STRING);
 
-	return child->value.string;
+	return jsonGetStringValue(child);
 }
 
 const char *jsonGetCString(JSONObject *o, const char *name) {
-	return stringAsCString(jsonGetString(o, name));
+	return cStringValue(getMember(o, name));
 }
 
-double jsonGetNumber(JSONObject *o, const char *name) {
-	assert(o->type == JSON_OBJECT);
+const char *jsonGetStringView(JSONObject *o, const char *name, size_t *length) {
+	JSONObject *child = getMember(o, name);
+
+	if (child == NULL) {
+		*length = 0;
+
+		return NULL; //Not found
+	}
+
+	return stringValueChars(child, length);
+}
 
-	JSONObject *child = dictionaryGet(o->value.object, name);
+double jsonGetNumber(JSONObject *o, const char *name) {
+	JSONObject *child = getMember(o, name);
 	
 	if (child == NULL) {
 		return 0.0; //Not found
 	}
 
-	assert(child->type == JSON_NUMBER);
+	return numberValue(child);
+}
+
+int64_t jsonGetInteger(JSONObject *o, const char *name) {
+	JSONObject *child = getMember(o, name);
+	
+	if (child == NULL) {
+		return 0; //Not found
+	}
 
-	return child->value.number;
+	return integerValue(child);
 }
 
-JSONObject *jsonGetObject(JSONObject *o, const char *name) {
-	assert(o->type == JSON_OBJECT);
+uint64_t jsonGetUnsigned(JSONObject *o, const char *name) {
+	JSONObject *child = getMember(o, name);
+	
+	if (child == NULL) {
+		return 0; //Not found
+	}
+
+	return unsignedValue(child);
+}
 
-	JSONObject *child = dictionaryGet(o->value.object, name);
+JSONObject *jsonGetObject(JSONObject *o, const char *name) {
+	JSONObject *child = getMember(o, name);
 	
 	if (child == NULL) {
 		return NULL; //Not found
@@ -263,9 +774,7 @@ JSONObject *jsonGetObject(JSONObject *o, const char *name) {
 }
 
 JSONObject *jsonGetArray(JSONObject *o, const char *name) {
-	assert(o->type == JSON_OBJECT);
-
-	JSONObject *child = dictionaryGet(o->value.object, name);
+	JSONObject *child = getMember(o, name);
 	
 	if (child == NULL) {
 		return NULL; //Not found
@@ -276,529 +785,3229 @@ JSONObject *jsonGetArray(JSONObject *o, const char *name) {
 	return child;
 }
 
-static JSONObject *_jsonGetByPath(JSONObject *o, const char *path) {
-	String *segment = newString();
-
-	while (*path != '\0') {
-		if (*path == '/') {
-			assert(o->type == JSON_OBJECT); //Parent must be object
-			o = dictionaryGet(o->value.object, 
-				stringAsCString(segment));	
-			segment->length = 0; //Reset
-		} else {
-			stringAppendChar(segment, *path);
-		}
-		++path;
-	}
-	if (segment->length > 0) {
-		assert(o->type == JSON_OBJECT); //Parent must be object
-		o = dictionaryGet(o->value.object, 
-			stringAsCString(segment));	
+const JSONKey *jsonInternKey(JSONParser *parser, const char *name) {
+	if (parser->keys == NULL) {
+		parser->keys = newKeyTable();
 	}
 
-	deleteString(segment);
+	size_t length = strlen(name);
 
-	return o;
+	return internKey(parser->keys, name, length, hashName(name, length));
 }
 
-/**
- * Find an object  that descends from the given object by the object name
- * hierarchy. All properties in the hierarchy must be objects (ie, can not
- * be array).
- */
-JSONObject *jsonGetObjectByPath(JSONObject *o, const char *path) {
-	o = _jsonGetByPath(o, path);
-
-	if (o == NULL) {
-		return NULL;
-	}
-
+static JSONObject *
+getMemberByKey(JSONObject *o, const JSONKey *key) {
 	assert(o->type == JSON_OBJECT);
 
-	return o;
+	return findMember(o, key->name, key->length, key->hash);
 }
 
-/**
- * Find an array  that descends from the given object by the object name
- * hierarchy. All properties in the hierarchy, except fo the last one,
- * must be objects (ie, can not * be array). The last property in the
- * path must be an array.
- */
-JSONObject *jsonGetArrayByPath(JSONObject *o, const char *path) {
-	o = _jsonGetByPath(o, path);
+String *jsonGetStringByKey(JSONObject *o, const JSONKey *key) {
+	JSONObject *child = getMemberByKey(o, key);
 
-	if (o == NULL) {
-		return NULL;
+	if (child == NULL) {
+		return NULL; //Not found
 	}
 
-	assert(o->type == JSON_ARRAY);
+	return jsonGetStringValue(child);
+}
 
-	return o;
+const char *jsonGetCStringByKey(JSONObject *o, const JSONKey *key) {
+	return cStringValue(getMemberByKey(o, key));
 }
 
-bool jsonGetBoolean(JSONObject *o, const char *name) {
-	assert(o->type == JSON_OBJECT);
+double jsonGetNumberByKey(JSONObject *o, const JSONKey *key) {
+	JSONObject *child = getMemberByKey(o, key);
 
-	JSONObject *child = dictionaryGet(o->value.object, name);
-	
 	if (child == NULL) {
-		return false; //Not found
+		return 0.0; //Not found
 	}
 
-	assert(child->type == JSON_BOOLEAN);
-
-	return child->value.booleanValue;
+	return numberValue(child);
 }
 
-bool jsonIsNull(JSONObject *o, const char *name) {
-	assert(o->type == JSON_OBJECT);
+int64_t jsonGetIntegerByKey(JSONObject *o, const JSONKey *key) {
+	JSONObject *child = getMemberByKey(o, key);
 
-	JSONObject *child = dictionaryGet(o->value.object, name);
-	
 	if (child == NULL) {
-		return true; //Not found
+		return 0; //Not found
 	}
 
-	if (child->type != JSON_NULL) {
-		return false;
+	return integerValue(child);
+}
+
+uint64_t jsonGetUnsignedByKey(JSONObject *o, const JSONKey *key) {
+	JSONObject *child = getMemberByKey(o, key);
+
+	if (child == NULL) {
+		return 0; //Not found
 	}
 
-	return child->value.isNull;
+	return unsignedValue(child);
 }
 
-static char pop(JSONParser *parser) {
-	char ch = '\0';
+JSONObject *jsonGetObjectByKey(JSONObject *o, const JSONKey *key) {
+	JSONObject *child = getMemberByKey(o, key);
 
-	//If we have anything in putback buffer
-	//then return it.
-	if (parser->putbackBuffer->length > 0) {
-		ch = stringGetChar(
-			parser->putbackBuffer,
-			parser->putbackBuffer->length - 1);
-		parser->putbackBuffer->length -= 1;
+	assert(child == NULL || child->type == JSON_OBJECT);
 
-		return ch;
-	}
+	return child;
+}
 
-	if (parser->streamFd >= 0) {
-		read(parser->streamFd, &ch, sizeof(ch));
-	} else {
-		if (parser->position >= parser->data->length) {
-			return 0;
-		}
+JSONObject *jsonGetArrayByKey(JSONObject *o, const JSONKey *key) {
+	JSONObject *child = getMemberByKey(o, key);
 
-		parser->position += 1;
+	assert(child == NULL || child->type == JSON_ARRAY);
 
-		ch = stringGetChar(parser->data, parser->position - 1);
+	return child;
+}
+
+bool jsonGetBooleanByKey(JSONObject *o, const JSONKey *key) {
+	JSONObject *child = getMemberByKey(o, key);
+
+	if (child == NULL) {
+		return false; //Not found
 	}
 
-	if (ch == '\n') {
-		parser->errorLine += 1;
+	assert(child->type == JSON_BOOLEAN);
+
+	return child->value.booleanValue;
+}
+
+bool jsonIsNullByKey(JSONObject *o, const JSONKey *key) {
+	JSONObject *child = getMemberByKey(o, key);
+
+	if (child == NULL) {
+		return true; //Not found
 	}
 
-	parser->lastReadChar = ch;
+	if (child->type != JSON_NULL) {
+		return false;
+	}
 
-	return ch;
+	return child->value.isNull;
 }
 
-static void putback(JSONParser *parser) {
-	assert(parser->lastReadChar != '\0');
+/*
+ * Returns the array index for a path segment or -1 if the
+ * segment is not a number.
+ */
+static int segmentIndex(const char *segment, size_t length) {
+	if (length == 0 || length > 9) {
+		return -1;
+	}
 
-	stringAppendChar(parser->putbackBuffer, parser->lastReadChar);
+	int index = 0;
 
-	if (parser->lastReadChar == '\n') {
-		parser->errorLine -= 1;
+	for (size_t i = 0; i < length; ++i) {
+		if (!isdigit((unsigned char) segment[i])) {
+			return -1;
+		}
+		index = index * 10 + (segment[i] - '0');
 	}
+
+	return index;
 }
 
-static char peek(JSONParser *parser) {
-	char ch = pop(parser);
+//Child of an object by name or of an array by index
+static JSONObject *pathChild(JSONObject *o, const char *name,
+	size_t length, unsigned int hash, int index) {
+	if (o->type == JSON_OBJECT) {
+		return findMember(o, name, length, hash);
+	}
 
-	if (ch != '\0') {
-		putback(parser);
+	EXPAND(o);
+
+	if (o->type == JSON_ARRAY && index >= 0 &&
+		(size_t) index < o->value.array.length) {
+		return o->value.array.items[index];
 	}
 
-	return ch;
+	return NULL;
 }
 
-JSONObject *newJSONObject(JSONType type) {
-	JSONObject *o = calloc(1, sizeof(JSONObject));
+static JSONObject *_jsonGetByPath(JSONObject *o, const char *path) {
+	const char *segment = path;
 
-	assert(o != NULL);
+	while (o != NULL) {
+		if (*path == '/' || *path == '\0') {
+			size_t length = path - segment;
 
-	o->type = type;
+			if (length > 0) {
+				o = pathChild(o, segment, length,
+					hashName(segment, length),
+					segmentIndex(segment, length));
+			}
+			if (*path == '\0') {
+				break;
+			}
+			segment = path + 1;
+		}
+		++path;
+	}
 
 	return o;
 }
 
-static void eatSpace(JSONParser *parser) {
-	char ch = pop(parser);
+/**
+ * Find an object  that descends from the given object by the object name
+ * hierarchy. A numeric name selects an item of an array.
+ */
+JSONObject *jsonGetObjectByPath(JSONObject *o, const char *path) {
+	o = _jsonGetByPath(o, path);
 
-	if (ch == 0) return;
+	if (o == NULL) {
+		return NULL;
+	}
 
-	while (isspace(ch)) {
-		ch = pop(parser);
+	assert(o->type == JSON_OBJECT);
 
-		if (ch == 0) return;
-	}
-	putback(parser);
+	return o;
 }
 
-static JSONObject* parseValue(JSONParser *parser);
-
-/*
- * Code stolen from: http://stackoverflow.com/a/4609989/1036017
+/**
+ * Find an array  that descends from the given object by the object name
+ * hierarchy. A numeric name selects an item of an array. The last
+ * property in the path must be an array.
  */
-static void unicodeToUTF8(int unicode, char *out, int *bytesWritten) {
-	char *pos = out;
+JSONObject *jsonGetArrayByPath(JSONObject *o, const char *path) {
+	o = _jsonGetByPath(o, path);
 
-	if (unicode<0x80) *pos++=unicode;
-	else if (unicode<0x800) *pos++=192+unicode/64, *pos++=128+unicode%64;
-	else if (unicode-0xd800u<0x800) {}
-	else if (unicode<0x10000) *pos++=224+unicode/4096, *pos++=128+unicode/64%64, *pos++=128+unicode%64;
-	else if (unicode<0x110000) *pos++=240+unicode/262144, *pos++=128+unicode/4096%64, *pos++=128+unicode/64%64, *pos++=128+unicode%64;
+	if (o == NULL) {
+		return NULL;
+	}
 
+	assert(o->type == JSON_ARRAY);
 
-	*bytesWritten = (pos - out);
+	return o;
 }
 
+//Compiles a path like "/orders/3/items/*/sku". Segments are split and
+//hashed once. A numeric segment also selects an item of an array and
+//"*" selects every item or member. The path is a single block of memory.
+JSONPath *jsonCompilePath(const char *path) {
+	size_t length = strlen(path);
+	int count = 0;
+
+	for (const char *c = path, *segment = path; ; ++c) {
+		if (*c == '/' || *c == '\0') {
+			if (c > segment) {
+				++count;
+			}
+			if (*c == '\0') {
+				break;
+			}
+			segment = c + 1;
+		}
+	}
+
+	JSONPath *compiled = malloc(sizeof(JSONPath) +
+		count * sizeof(JSONPathSegment) + length + 1);
 
-static String* parseString(JSONParser *parser) {
-	eatSpace(parser);
+	assert(compiled != NULL);
 
-	char ch = pop(parser);
+	compiled->segments = (JSONPathSegment*) (compiled + 1);
+	compiled->length = 0;
 
-	FAIL(ch == 0, parser, ERROR_SYNTAX, "Premature end of document while parsing string.");
-	assert(ch == '"');
+	char *names = (char*) (compiled->segments + count);
 
-	String *s = newString();
+	memcpy(names, path, length + 1);
 
-	while ((ch = pop(parser)) != '"') {
-		if (ch == 0) {
-			save_error(parser, ERROR_SYNTAX, "Premature end of document while parsing string.");
-			deleteString(s);
-			return NULL;
+	for (char *c = names, *segment = names; ; ++c) {
+		if (*c == '/' || *c == '\0') {
+			if (c > segment) {
+				JSONPathSegment *s = compiled->segments + compiled->length++;
+
+				s->name = segment;
+				s->length = c - segment;
+				s->hash = hashName(segment, s->length);
+				s->index = segmentIndex(segment, s->length);
+				s->wildcard = s->length == 1 && *segment == '*';
+			}
+			if (*c == '\0') {
+				break;
+			}
+			*c = '\0';
+			segment = c + 1;
 		}
+	}
 
-		if (ch == '\\') {
-			//Escape handling
+	return compiled;
+}
 
-			char escaped = pop(parser);
+void deleteJSONPath(JSONPath *path) {
+	free(path);
+}
 
-			if (escaped == 0) {
-				save_error(parser, ERROR_SYNTAX, "Invalid escaped character in string.");
-				deleteString(s);
+typedef struct _PathMatch {
+	void (*fn)(JSONObject *match, void *context);
+	void *context;
+	JSONObject **results;
+	int maxResults;
+	int count;
+	bool firstOnly;
+} PathMatch;
 
-				return NULL;
+/*
+ * Walks the path from the given segment. Recurses only for
+ * wildcards. Returns false to stop the search.
+ */
+static bool walkPath(JSONPath *path, int segment, JSONObject *o, PathMatch *m) {
+	for (; segment < path->length; ++segment) {
+		JSONPathSegment *s = path->segments + segment;
+
+		if (s->wildcard) {
+			EXPAND(o);
+
+			if (o->type == JSON_ARRAY) {
+				for (size_t i = 0; i < o->value.array.length; ++i) {
+					if (!walkPath(path, segment + 1,
+						o->value.array.items[i], m)) {
+						return false;
+					}
+				}
+			} else if (o->type == JSON_OBJECT) {
+				for (size_t i = 0; i < o->value.object.length; ++i) {
+					if (!walkPath(path, segment + 1,
+						o->value.object.members[i].value, m)) {
+						return false;
+					}
+				}
 			}
 
-			if (escaped == 't') {
-				ch = '\t';
-			} else if (escaped == 'r') {
-				ch = '\r';
-			} else if (escaped == 'n') {
-				ch = '\n';
-			} else if (escaped == 'b') {
-				ch = '\b';
-			} else if (escaped == '"') {
-				ch = '"';
-			} else if (escaped == '\\') {
-				ch = '\\';
-			} else if (escaped == 'u') {
-				//Unicode escape. Must be 2 hex digits.
-				char in[5];
-				
-				in[0] = pop(parser);
-				in[1] = pop(parser);
-				in[2] = pop(parser);
-				in[3] = pop(parser);
-				in[4] = '\0';
+			return true;
+		}
 
-				int unicode;
-				sscanf(in, "%04X", &unicode);
+		o = pathChild(o, s->name, s->length, s->hash, s->index);
 
-				char out[4];
-				int bytesWritten;
+		if (o == NULL) {
+			return true;
+		}
+	}
 
-				unicodeToUTF8(unicode, out, &bytesWritten);
+	if (m->count < m->maxResults) {
+		m->results[m->count] = o;
+	}
+	m->count += 1;
 
-				if (bytesWritten == 0) {
-					save_error(parser, ERROR_SYNTAX, "Failed to convert UNICODE to UTF-8.");
-					continue;
-				}
+	if (m->fn != NULL) {
+		m->fn(o, m->context);
+	}
 
-				for (int i = 0; i < bytesWritten; ++i) {
-					stringAppendChar(s, out[i]);
-				}
+	return !m->firstOnly;
+}
 
-				continue;
-			}
-		}
+//Returns the first match of the path or NULL
+JSONObject *jsonPathGet(JSONPath *path, JSONObject *o) {
+	JSONObject *result = NULL;
+	PathMatch m = {NULL, NULL, &result, 1, 0, true};
 
-		stringAppendChar(s, ch);
-	}
+	walkPath(path, 0, o, &m);
 
-	return s;
+	return result;
 }
 
-/**
- * Reads the text for next number, boolean and null value.
+/*
+ * Stores up to maxResults matches in results and returns the
+ * total number of matches.
  */
-static String *readValueToken(JSONParser *parser) {
-	eatSpace(parser);
+int jsonPathSelect(JSONPath *path, JSONObject *o, JSONObject **results, int maxResults) {
+	PathMatch m = {NULL, NULL, results, maxResults, 0, false};
 
-	String *s = newString();
+	walkPath(path, 0, o, &m);
 
-	while (1) {
-		char ch = pop(parser);
+	return m.count;
+}
 
-		if (ch == 0) {
-			save_error(parser, ERROR_SYNTAX, "Premature end of document while looking for a value.");
-			deleteString(s);
-			return NULL;
-		} else if (ch == '}' || ch == ']' || ch == ',') {
-			putback(parser);
+//Calls fn for every match and returns the number of matches
+int jsonPathForEach(JSONPath *path, JSONObject *o,
+	void (*fn)(JSONObject *match, void *context), void *context) {
+	PathMatch m = {fn, context, NULL, 0, 0, false};
 
-			break;
-		}
+	walkPath(path, 0, o, &m);
 
-		stringAppendChar(s, ch);
+	return m.count;
+}
+
+bool jsonGetBoolean(JSONObject *o, const char *name) {
+	JSONObject *child = getMember(o, name);
+	
+	if (child == NULL) {
+		return false; //Not found
 	}
 
-	stringTrim(s);
+	assert(child->type == JSON_BOOLEAN);
 
-	return s;
+	return child->value.booleanValue;
 }
 
-static double parseNumber(JSONParser *parser) {
-	String *s = readValueToken(parser);
+bool jsonIsNull(JSONObject *o, const char *name) {
+	JSONObject *child = getMember(o, name);
+	
+	if (child == NULL) {
+		return true; //Not found
+	}
 
-	if (s == NULL) {
-		return 0.0;
+	if (child->type != JSON_NULL) {
+		return false;
 	}
 
-	double d = 0.0;
-	const char *str = stringAsCString(s);
+	return child->value.isNull;
+}
 
-	if (sscanf(str, "%le", &d) == 0) {
-		save_error(parser, ERROR_SYNTAX, "Failed to parse number.");
+//Character classes of the lexer
+#define CHAR_SPACE 0x1 //Skipped between tokens, like isspace()
+#define CHAR_DIGIT 0x2
+#define CHAR_NUMBER 0x4 //May be part of a number
+#define CHAR_DELIMITER 0x8 //May follow a number, boolean or null
+#define CHAR_SEPARATOR 0x10 //Can not start a value
+#define CHAR_STRING_END 0x20 //Ends a run of plain characters in a string
+
+#define CHAR_IS(ch, class) (charClass[(unsigned char) (ch)] & (class))
+
+static const unsigned char charClass[256] = {
+	[' '] = CHAR_SPACE | CHAR_DELIMITER,
+	['\t'] = CHAR_SPACE | CHAR_DELIMITER,
+	['\r'] = CHAR_SPACE | CHAR_DELIMITER,
+	['\n'] = CHAR_SPACE | CHAR_DELIMITER,
+	['\v'] = CHAR_SPACE,
+	['\f'] = CHAR_SPACE,
+	['0'] = CHAR_DIGIT | CHAR_NUMBER,
+	['1'] = CHAR_DIGIT | CHAR_NUMBER,
+	['2'] = CHAR_DIGIT | CHAR_NUMBER,
+	['3'] = CHAR_DIGIT | CHAR_NUMBER,
+	['4'] = CHAR_DIGIT | CHAR_NUMBER,
+	['5'] = CHAR_DIGIT | CHAR_NUMBER,
+	['6'] = CHAR_DIGIT | CHAR_NUMBER,
+	['7'] = CHAR_DIGIT | CHAR_NUMBER,
+	['8'] = CHAR_DIGIT | CHAR_NUMBER,
+	['9'] = CHAR_DIGIT | CHAR_NUMBER,
+	['-'] = CHAR_NUMBER,
+	['+'] = CHAR_NUMBER,
+	['.'] = CHAR_NUMBER,
+	['e'] = CHAR_NUMBER,
+	['E'] = CHAR_NUMBER,
+	[','] = CHAR_DELIMITER | CHAR_SEPARATOR,
+	['}'] = CHAR_DELIMITER | CHAR_SEPARATOR,
+	[']'] = CHAR_DELIMITER | CHAR_SEPARATOR,
+	[':'] = CHAR_SEPARATOR,
+	['"'] = CHAR_STRING_END,
+	['\\'] = CHAR_STRING_END,
+	['\0'] = CHAR_STRING_END
+};
+
+/*
+ * Fills the stream buffer with the next block of data from
+ * the stream. A short read is fine, we simply use what we got.
+ * Returns false at end of stream or on a read error.
+ */
+static bool refill(JSONParser *parser) {
+	ssize_t sz = 0;
+	STAT_START(started);
+
+	//The invalid byte of the last block has been reached
+	if (parser->utf8State == UTF8_REJECT) {
+		save_error(parser, ERROR_SYNTAX, "Invalid UTF-8 in document.");
+		parser->streamBufferLength = 0;
+		parser->streamBufferPosition = 0;
 
-		d = 0.0;
+		return false;
 	}
 
-	deleteString(s);
+	do {
+		sz = read(parser->streamFd, parser->streamBuffer,
+			parser->streamBufferCapacity);
+		STAT_ADD(parser, reads, 1);
+	} while (sz < 0 && errno == EINTR);
 
-	return d;
-}
+	STAT_TIME(parser, readSeconds, started);
 
-static bool parseBool(JSONParser *parser) {
-	String *s = readValueToken(parser);
+	if (sz < 0) {
+		save_error(parser, ERROR_IO, "Failed to read from stream.");
+	}
+	if (sz == 0 && parser->validateUTF8 && parser->utf8State != UTF8_ACCEPT) {
+		save_error(parser, ERROR_SYNTAX, "Invalid UTF-8 in document.");
+	}
+	if (sz <= 0) {
+		parser->streamBufferLength = 0;
+		parser->streamBufferPosition = 0;
 
-	if (s == NULL) {
 		return false;
 	}
 
-	bool val = false;
-	
-	if (strcmp(stringAsCString(s), "true") == 0) {
-		val = true;
-	} else if (strcmp(stringAsCString(s), "false") == 0) {
-		val = false;
-	} else {
-		//Error
-		save_error(parser, ERROR_SYNTAX, "Invalid boolean value.");
+	STAT_ADD(parser, bytes, sz);
+
+	if (parser->validateUTF8) {
+		//Only the bytes before an invalid one are parsed
+		sz = validateUTF8(parser->streamBuffer, sz, &parser->utf8State);
+
+		if (sz == 0) {
+			return refill(parser);
+		}
 	}
 
-	deleteString(s);
+	parser->streamBufferLength = sz;
+	parser->streamBufferPosition = 0;
 
-	return val;
+	return true;
 }
 
-static bool parseNull(JSONParser *parser) {
-	String *s = readValueToken(parser);
+/*
+ * Returns the next character or 0 at the end. In memory only the
+ * position moves, lines are counted by save_error().
+ */
+static char pop(JSONParser *parser) {
+	if (parser->streamFd < 0) {
+		return parser->position < parser->data->length ?
+			parser->data->buffer[parser->position++] : 0;
+	}
 
-	if (s == NULL) {
-		return false;
+	if (parser->streamBufferPosition >= parser->streamBufferLength
+		&& !refill(parser)) {
+		parser->lastReadChar = '\0';
+
+		return 0;
 	}
 
-	bool val = strcmp(stringAsCString(s), "null") == 0;
+	char ch = parser->streamBuffer[parser->streamBufferPosition++];
 
-	deleteString(s);
+	if (ch == '\n') {
+		parser->errorLine += 1;
+	}
 
-	return val;
+	parser->lastReadChar = ch;
+
+	return ch;
 }
 
-static JSONObject *parseObject(JSONParser *parser) {
-	char ch = pop(parser);
+/*
+ * Steps the read cursor back by one character. Only the last
+ * character returned by pop() can be put back, and only once.
+ * A refill only happens when the buffer is exhausted, so the
+ * last read character is always still in the buffer.
+ */
+static void putback(JSONParser *parser) {
+	STAT_ADD(parser, putbacks, 1);
 
-	FAIL(ch == 0, parser, ERROR_SYNTAX, "Premature end of document while parsing an object.");
-	FAIL(ch != '{', parser, ERROR_SYNTAX, "Object does not start with '{'");
+	if (parser->streamFd < 0) {
+		assert(parser->position > 0);
+		parser->position -= 1;
 
-	JSONObject *o = newJSONObject(JSON_OBJECT);
-	Dictionary *d = newDictionary();
-	String *name = NULL;
+		return;
+	}
 
-	o->value.object = d;
+	assert(parser->lastReadChar != '\0');
+	assert(parser->streamBufferPosition > 0);
+	parser->streamBufferPosition -= 1;
 
-	while (1) {
-		eatSpace(parser);
-		ch = pop(parser);
+	if (parser->lastReadChar == '\n') {
+		parser->errorLine -= 1;
+	}
 
-		if (ch == 0) {
-			save_error(parser, ERROR_SYNTAX, "Premature end of document while parsing an object.");
-			break;
-		}
+	parser->lastReadChar = '\0';
+}
+
+static char peek(JSONParser *parser) {
+	if (parser->streamFd < 0) {
+		return parser->position < parser->data->length ?
+			parser->data->buffer[parser->position] : 0;
+	}
+
+	char ch = pop(parser);
+
+	if (ch != '\0') {
+		putback(parser);
+	}
+
+	return ch;
+}
+
+JSONObject *newJSONObject(JSONType type) {
+	JSONObject *o = calloc(1, sizeof(JSONObject));
+
+	assert(o != NULL);
+
+	o->type = type;
+
+	return o;
+}
+
+/*
+ * Allocates a node for the document being parsed. Arena
+ * nodes are flagged so that jsonClear() does not free them.
+ */
+static JSONObject *newNode(JSONParser *parser, JSONType type) {
+	STAT_ADD(parser, allocations, 1);
+	STAT_ADD(parser, allocatedBytes, sizeof(JSONObject));
+
+	if (parser->arena == NULL) {
+		return newJSONObject(type);
+	}
+
+	JSONObject *o = arenaCalloc(parser->arena, sizeof(JSONObject));
+
+	o->type = type;
+	o->flags = JSON_FLAG_ARENA;
+
+	return o;
+}
+
+/*
+ * Allocates memory that will be owned by a node of the
+ * document being parsed.
+ */
+static void *allocBlock(JSONParser *parser, size_t size) {
+	STAT_ADD(parser, allocations, 1);
+	STAT_ADD(parser, allocatedBytes, size);
+
+	if (parser->arena != NULL) {
+		return arenaAlloc(parser->arena, size);
+	}
+
+	void *block = malloc(size);
+
+	assert(block != NULL);
+
+	return block;
+}
+
+static void reserveText(JSONParser *parser, size_t length) {
+	if (parser->textLength + length <= parser->textCapacity) {
+		return;
+	}
+
+	size_t capacity = parser->textCapacity == 0 ? 256 : parser->textCapacity;
+
+	while (capacity < parser->textLength + length) {
+		capacity *= 2;
+	}
+
+	parser->text = realloc(parser->text, capacity);
+
+	assert(parser->text != NULL);
+
+	parser->textCapacity = capacity;
+}
+
+static void appendTextChar(JSONParser *parser, char ch) {
+	if (parser->textLength == parser->textCapacity) {
+		reserveText(parser, 1);
+	}
+
+	parser->text[parser->textLength++] = ch;
+}
+
+static void pushPending(JSONParser *parser, const char *name,
+	size_t nameOffset, unsigned int nameLength, JSONObject *value) {
+	if (parser->pendingLength == parser->pendingCapacity) {
+		parser->pendingCapacity = parser->pendingCapacity == 0 ?
+			64 : parser->pendingCapacity * 2;
+		parser->pending = realloc(parser->pending,
+			parser->pendingCapacity * sizeof(JSONPendingMember));
+
+		assert(parser->pending != NULL);
+	}
+
+	JSONPendingMember *m = parser->pending + parser->pendingLength++;
+
+	m->name = name;
+	m->nameOffset = nameOffset;
+	m->nameLength = nameLength;
+	m->hash = hashName(name != NULL ? name : parser->text + nameOffset,
+		nameLength);
+	m->value = value;
+
+	if (parser->internKeys) {
+		//The member refers to the interned name instead of a copy
+		m->name = internKey(parser->keys,
+			name != NULL ? name : parser->text + nameOffset,
+			nameLength, m->hash)->name;
+	}
+}
+
+/*
+ * Creates a String from the scratch text starting at offset and
+ * removes that text from the scratch.
+ */
+static String *newStringFromText(JSONParser *parser, size_t offset) {
+	size_t length = parser->textLength - offset;
+	const char *chars = parser->text + offset;
+	String *s;
+
+	STAT_ADD(parser, allocations, 2);
+	STAT_ADD(parser, allocatedBytes, sizeof(String) + length + 1);
+
+	if (parser->arena != NULL) {
+		s = arenaAlloc(parser->arena, sizeof(String));
+		s->buffer = arenaAlloc(parser->arena, length + 1);
+		memcpy(s->buffer, chars, length);
+		s->buffer[length] = '\0';
+		s->length = length;
+		s->capacity = length + 1;
+	} else {
+		s = newStringWithCapacity(length);
+		stringAppendBuffer(s, chars, length);
+	}
+
+	parser->textLength = offset;
+
+	return s;
+}
+
+/*
+ * Moves the members pending since index first into a single block
+ * owned by the object. The block holds the members, the hash index
+ * of a large object and the NULL terminated names.
+ */
+static void closeObject(JSONParser *parser, JSONObject *o, size_t first, size_t textMark) {
+	size_t count = parser->pendingLength - first;
+
+	if (count > 0) {
+		JSONPendingMember *pending = parser->pending + first;
+		size_t slots = indexSlots(count);
+		size_t nameBytes = 0;
+
+		for (size_t i = 0; i < count; ++i) {
+			if (pending[i].name == NULL) {
+				nameBytes += pending[i].nameLength + 1;
+			}
+		}
+
+		JSONMember *members = allocBlock(parser,
+			count * sizeof(JSONMember) +
+			slots * sizeof(unsigned int) + nameBytes);
+		unsigned int *index = memberIndex(members, count);
+		char *names = (char*) (index + slots);
+		size_t mask = slots - 1;
+
+		memset(index, 0, slots * sizeof(unsigned int));
+
+		for (size_t i = 0; i < count; ++i) {
+			JSONMember *m = members + i;
+
+			m->nameLength = pending[i].nameLength;
+			m->hash = pending[i].hash;
+			m->value = pending[i].value;
+
+			if (pending[i].name != NULL) {
+				m->name = pending[i].name;
+			} else {
+				memcpy(names, parser->text + pending[i].nameOffset,
+					m->nameLength);
+				names[m->nameLength] = '\0';
+				m->name = names;
+				names += m->nameLength + 1;
+			}
+
+			if (slots == 0) {
+				continue;
+			}
+
+			//A repeated name replaces the earlier one in the index
+			size_t slot = m->hash & mask;
+
+			while (index[slot] != 0) {
+				JSONMember *other = members + index[slot] - 1;
+
+				if (other->hash == m->hash &&
+					other->nameLength == m->nameLength &&
+					memcmp(other->name, m->name, m->nameLength) == 0) {
+					break;
+				}
+				slot = (slot + 1) & mask;
+			}
+			index[slot] = (unsigned int) i + 1;
+		}
+
+		o->value.object.members = members;
+	}
+
+	o->value.object.length = count;
+	parser->pendingLength = first;
+	parser->textLength = textMark;
+}
+
+static void closeArray(JSONParser *parser, JSONObject *o, size_t first) {
+	size_t count = parser->pendingLength - first;
+
+	if (count > 0) {
+		JSONObject **items = allocBlock(parser, count * sizeof(JSONObject*));
+
+		for (size_t i = 0; i < count; ++i) {
+			items[i] = parser->pending[first + i].value;
+		}
+
+		o->value.array.items = items;
+	}
+
+	o->value.array.length = count;
+	parser->pendingLength = first;
+}
+
+static void eatSpace(JSONParser *parser) {
+	if (parser->streamFd < 0) {
+		const char *data = parser->data->buffer;
+		size_t end = parser->data->length;
+		size_t pos = parser->position;
+
+		while (pos < end && CHAR_IS(data[pos], CHAR_SPACE)) {
+			++pos;
+		}
+
+		parser->position = pos;
+
+		return;
+	}
+
+	char ch = pop(parser);
+
+	if (ch == 0) return;
+
+	while (CHAR_IS(ch, CHAR_SPACE)) {
+		ch = pop(parser);
+
+		if (ch == 0) return;
+	}
+	putback(parser);
+}
+
+/*
+ * Returns the String of a JSON_STRING value. A view is copied
+ * and unescaped the first time this is called.
+ */
+String *jsonGetStringValue(JSONObject *o) {
+	assert(o->type == JSON_STRING);
+	//Strings of an in-place parse have no String
+	assert((o->flags & JSON_FLAG_IN_PLACE) == 0);
+
+	if ((o->flags & JSON_FLAG_VIEW) == 0) {
+		return o->value.string;
+	}
+
+	JSONStringView *view = o->value.view;
+
+	if (view->string != NULL) {
+		return view->string;
+	}
+
+	String *s;
+
+	if (view->arena != NULL) {
+		s = arenaAlloc(view->arena, sizeof(String));
+		s->buffer = arenaAlloc(view->arena, view->length + 1);
+	} else {
+		s = newStringWithCapacity(view->length + 1);
+	}
+
+	if (o->flags & JSON_FLAG_ESCAPED) {
+		s->length = unescapeString(view->start, view->length, s->buffer);
+	} else {
+		memcpy(s->buffer, view->start, view->length);
+		s->length = view->length;
+	}
+	s->buffer[s->length] = '\0';
+
+	if (view->arena != NULL) {
+		s->capacity = s->length + 1;
+	}
+
+	view->string = s;
+
+	return s;
+}
+
+/*
+ * Returns the characters of a JSON_STRING value without creating
+ * a String, unless the value needs to be unescaped.
+ */
+static const char *stringValueChars(JSONObject *o, size_t *length) {
+	assert(o->type == JSON_STRING);
+
+	if (o->flags & JSON_FLAG_IN_PLACE) {
+		*length = o->value.inPlace.length;
+
+		return o->value.inPlace.chars;
+	}
+	if ((o->flags & (JSON_FLAG_VIEW | JSON_FLAG_ESCAPED)) == JSON_FLAG_VIEW) {
+		*length = o->value.view->length;
+
+		return o->value.view->start;
+	}
+
+	String *s = jsonGetStringValue(o);
+
+	*length = s->length;
+
+	return s->buffer;
+}
+
+//Returns the NULL terminated characters of a string value or NULL
+static const char *cStringValue(JSONObject *o) {
+	if (o == NULL) {
+		return NULL; //Not found
+	}
+
+	assert(o->type == JSON_STRING);
+
+	if (o->flags & JSON_FLAG_IN_PLACE) {
+		return o->value.inPlace.chars;
+	}
+
+	return stringAsCString(jsonGetStringValue(o));
+}
+
+
+
+/*
+ * Copies the characters of a string in memory up to the next quote,
+ * escape or end to the scratch text. Returns how many were copied.
+ */
+static size_t copyPlainRun(JSONParser *parser) {
+	const char *data = parser->data->buffer;
+	size_t end = parser->data->length;
+	size_t start = parser->position;
+	size_t pos = start;
+
+	while (pos < end && !CHAR_IS(data[pos], CHAR_STRING_END)) {
+		++pos;
+	}
+
+	if (pos > start) {
+		reserveText(parser, pos - start);
+		memcpy(parser->text + parser->textLength, data + start, pos - start);
+		parser->textLength += pos - start;
+		parser->position = pos;
+	}
+
+	return pos - start;
+}
+
+/*
+ * Decodes the next string in the document and appends it to the
+ * scratch text.
+ */
+static bool scanString(JSONParser *parser) {
+	eatSpace(parser);
+
+	char ch = pop(parser);
+
+	if (ch == 0) {
+		save_error(parser, ERROR_SYNTAX, "Premature end of document while parsing string.");
+		return false;
+	}
+	assert(ch == '"');
+
+	//High surrogate of a \u escape that may be followed by its pair
+	int high = 0;
+
+	while (1) {
+		if (parser->streamFd < 0 && copyPlainRun(parser) > 0) {
+			high = 0;
+		}
+		if ((ch = pop(parser)) == '"') {
+			break;
+		}
+		if (ch == 0) {
+			save_error(parser, ERROR_SYNTAX, "Premature end of document while parsing string.");
+			return false;
+		}
+
+		if (ch == '\\') {
+			//Escape handling
+
+			char escaped = pop(parser);
+
+			if (escaped == 0) {
+				save_error(parser, ERROR_SYNTAX, "Invalid escaped character in string.");
+
+				return false;
+			}
+
+			if (escaped == 't') {
+				ch = '\t';
+			} else if (escaped == 'r') {
+				ch = '\r';
+			} else if (escaped == 'n') {
+				ch = '\n';
+			} else if (escaped == 'b') {
+				ch = '\b';
+			} else if (escaped == 'f') {
+				ch = '\f';
+			} else if (escaped == '"') {
+				ch = '"';
+			} else if (escaped == '\\') {
+				ch = '\\';
+			} else if (escaped == '/') {
+				ch = '/';
+			} else if (escaped == 'u') {
+				//Unicode escape. Must be 2 hex digits.
+				char in[5];
+				
+				in[0] = pop(parser);
+				in[1] = pop(parser);
+				in[2] = pop(parser);
+				in[3] = pop(parser);
+				in[4] = '\0';
+
+				int unicode = hexValue(in);
+
+				if (unicode < 0) {
+					save_error(parser, ERROR_SYNTAX, "Invalid escaped character in string.");
+
+					return false;
+				}
+
+				reserveText(parser, 4);
+				parser->textLength += decodeEscape(unicode, &high,
+					parser->text + parser->textLength);
+
+				continue;
+			} else {
+				save_error(parser, ERROR_SYNTAX, "Invalid escaped character in string.");
+
+				return false;
+			}
+		}
+
+		appendTextChar(parser, ch);
+		high = 0;
+	}
+
+	return true;
+}
+
+/*
+ * Finds the next string in the data without decoding it. Used in
+ * zero copy mode. Sets *start and *length to the characters between
+ * the quotes and *escaped to whether there are escape sequences.
+ */
+static bool scanStringView(JSONParser *parser, const char **start,
+	size_t *length, bool *escaped) {
+	eatSpace(parser);
+
+	char ch = pop(parser);
+
+	if (ch == 0) {
+		save_error(parser, ERROR_SYNTAX, "Premature end of document while parsing string.");
+		return false;
+	}
+	assert(ch == '"');
+
+	const char *data = parser->data->buffer;
+	size_t end = parser->data->length;
+	size_t pos = parser->position;
+
+	const char *error;
+	const char *quote = findStringEnd(data + pos, data + end, escaped, &error);
+
+	if (error != NULL) {
+		parser->position = quote - data;
+		save_error(parser, ERROR_SYNTAX, error);
+		return false;
+	}
+
+	pos = quote - data;
+
+	*start = data + parser->position;
+	*length = pos - parser->position;
+	parser->position = pos + 1;
+
+	return true;
+}
+
+static bool zeroCopy(JSONParser *parser) {
+	return (parser->zeroCopyStrings || parser->inPlace) && parser->data != NULL;
+}
+
+/*
+ * Decodes a string found by scanStringView() back into the parsed
+ * data of an in-place parse and NULL terminates it. The decoded string
+ * is never longer, so the terminator at most replaces the closing quote.
+ * A decoded "\n" must not count as a line, so the lines up to the string
+ * are counted before it is overwritten.
+ */
+static size_t
+decodeInPlace(JSONParser *parser, const char *start, size_t length, bool escaped) {
+	char *chars = (char*) start;
+
+	if (escaped) {
+		size_t end = start + length - parser->data->buffer;
+
+		parser->errorLine += countLines(parser->data->buffer + parser->lineOffset,
+			end - parser->lineOffset);
+		parser->lineOffset = end;
+		length = unescapeString(start, length, chars);
+	}
+
+	chars[length] = '\0';
+
+	return length;
+}
+
+static String* parseString(JSONParser *parser) {
+	size_t offset = parser->textLength;
+
+	if (!scanString(parser)) {
+		parser->textLength = offset;
+
+		return NULL;
+	}
+
+	return newStringFromText(parser, offset);
+}
+
+/*
+ * Parses a string value into o. In zero copy mode the value
+ * is a view into the parsed data.
+ */
+static void parseStringValue(JSONParser *parser, JSONObject *o) {
+	if (!zeroCopy(parser)) {
+		String *str = parseString(parser);
+
+		if (str != NULL) {
+			o->type = JSON_STRING;
+			o->value.string = str;
+		}
+
+		return;
+	}
+
+	const char *start;
+	size_t length;
+	bool escaped;
+
+	if (!scanStringView(parser, &start, &length, &escaped)) {
+		return;
+	}
+
+	if (parser->inPlace) {
+		o->type = JSON_STRING;
+		o->flags |= JSON_FLAG_IN_PLACE;
+		o->value.inPlace.chars = start;
+		o->value.inPlace.length = decodeInPlace(parser, start, length, escaped);
+
+		return;
+	}
+
+	JSONStringView *view = allocBlock(parser, sizeof(JSONStringView));
+
+	view->start = start;
+	view->length = length;
+	view->string = NULL;
+	view->arena = parser->arena;
+
+	o->type = JSON_STRING;
+	o->flags |= JSON_FLAG_VIEW | (escaped ? JSON_FLAG_ESCAPED : 0);
+	o->value.view = view;
+}
+
+/**
+ * Reads the text for next number, boolean and null value.
+ */
+static String *readValueToken(JSONParser *parser) {
+	eatSpace(parser);
+
+	String *s = newString();
+
+	while (1) {
+		char ch = pop(parser);
+
+		if (ch == 0) {
+			save_error(parser, ERROR_SYNTAX, "Premature end of document while looking for a value.");
+			deleteString(s);
+			return NULL;
+		} else if (ch == '}' || ch == ']' || ch == ',') {
+			putback(parser);
+
+			break;
+		}
+
+		stringAppendChar(s, ch);
+	}
+
+	stringTrim(s);
+
+	return s;
+}
+
+static bool isNumberChar(char ch) {
+	return CHAR_IS(ch, CHAR_NUMBER);
+}
+
+/*
+ * Scans the next number. In memory the number is scanned right
+ * where it is. A number from a stream is first collected in the
+ * scratch text.
+ */
+static bool scanNumberValue(JSONParser *parser, Number *n) {
+	size_t length;
+
+	eatSpace(parser);
+
+	if (parser->streamFd < 0) {
+		const char *start = parser->data->buffer + parser->position;
+
+		length = scanNumber(start,
+			parser->data->buffer + parser->data->length, n);
+
+		parser->position += length;
+	} else {
+		size_t offset = parser->textLength;
+		char ch;
+
+		while (isNumberChar(ch = pop(parser))) {
+			appendTextChar(parser, ch);
+		}
+		if (ch != 0) {
+			putback(parser);
+		}
+
+		size_t count = parser->textLength - offset;
+
+		length = scanNumber(parser->text + offset,
+			parser->text + parser->textLength, n);
+
+		if (length != count) {
+			length = 0;
+		}
+
+		parser->textLength = offset;
+	}
+
+	if (length == 0) {
+		save_error(parser, ERROR_SYNTAX, "Failed to parse number.");
+		return false;
+	}
+
+	return true;
+}
+
+static void setNumber(JSONParser *parser, JSONObject *o, Number n) {
+	if (n.kind == NUMBER_DOUBLE || !parser->parseIntegers) {
+		o->type = JSON_NUMBER;
+		o->value.number = n.kind == NUMBER_DOUBLE ? n.value.d :
+			n.kind == NUMBER_INTEGER ? (double) n.value.i :
+			(double) n.value.u;
+	} else {
+		o->type = JSON_INTEGER;
+		o->value.integer = n.value.i;
+
+		if (n.kind == NUMBER_UNSIGNED) {
+			o->flags |= JSON_FLAG_UNSIGNED;
+			o->value.unsignedInteger = n.value.u;
+		}
+	}
+}
+
+static void parseNumber(JSONParser *parser, JSONObject *o) {
+	Number n;
+
+	if (scanNumberValue(parser, &n)) {
+		setNumber(parser, o, n);
+	}
+}
+
+/*
+ * Matches a literal in memory without copying it. The literal must be
+ * followed by ',', '}' or ']', spaces aside, as readValueToken() wants.
+ * Returns false with the position unchanged otherwise.
+ */
+static bool matchWord(JSONParser *parser, const char *word, size_t length) {
+	if (parser->streamFd >= 0) {
+		return false;
+	}
+
+	eatSpace(parser);
+
+	const char *data = parser->data->buffer;
+	size_t end = parser->data->length;
+	size_t pos = parser->position;
+
+	if (end - pos < length || memcmp(data + pos, word, length) != 0) {
+		return false;
+	}
+
+	size_t next = pos + length;
+
+	while (next < end && CHAR_IS(data[next], CHAR_SPACE)) {
+		++next;
+	}
+	if (next == end || data[next] == ':' ||
+		!CHAR_IS(data[next], CHAR_SEPARATOR)) {
+		return false;
+	}
+
+	parser->position = pos + length;
+
+	return true;
+}
+
+static bool parseBool(JSONParser *parser) {
+	if (matchWord(parser, "true", 4)) {
+		return true;
+	} else if (matchWord(parser, "false", 5)) {
+		return false;
+	}
+
+	String *s = readValueToken(parser);
+
+	if (s == NULL) {
+		return false;
+	}
+
+	bool val = false;
+	
+	if (strcmp(stringAsCString(s), "true") == 0) {
+		val = true;
+	} else if (strcmp(stringAsCString(s), "false") == 0) {
+		val = false;
+	} else {
+		//Error
+		save_error(parser, ERROR_SYNTAX, "Invalid boolean value.");
+	}
+
+	deleteString(s);
+
+	return val;
+}
+
+static bool parseNull(JSONParser *parser) {
+	if (matchWord(parser, "null", 4)) {
+		return true;
+	}
+
+	String *s = readValueToken(parser);
+
+	if (s == NULL) {
+		return false;
+	}
+
+	bool val = strcmp(stringAsCString(s), "null") == 0;
+
+	if (!val) {
+		save_error(parser, ERROR_SYNTAX, "Invalid null value.");
+	}
+
+	deleteString(s);
+
+	return val;
+}
+
+/*
+ * Skips over the next value without creating anything. Only
+ * brackets and the ends of strings are looked at.
+ */
+static void skipValue(JSONParser *parser) {
+	eatSpace(parser);
+
+	int depth = 0;
+
+	if (parser->streamFd < 0) {
+		const char *data = parser->data->buffer;
+		size_t end = parser->data->length;
+		size_t pos = parser->position;
+
+		while (pos < end) {
+			char ch = data[pos++];
+
+			if (depth == 0 && CHAR_IS(ch, CHAR_SEPARATOR)) {
+				parser->position = pos - 1;
+				save_error(parser, ERROR_SYNTAX, "Invalid value.");
+				return;
+			}
+			if (ch == '"') {
+				while (pos < end && data[pos] != '"') {
+					if (data[pos] == '\\') {
+						++pos;
+					}
+					++pos;
+				}
+				++pos;
+			} else if (ch == '{' || ch == '[') {
+				++depth;
+				continue;
+			} else if (ch == '}' || ch == ']') {
+				--depth;
+			} else if (CHAR_IS(ch, CHAR_SPACE)) {
+				continue;
+			} else if (depth == 0) {
+				//A number, boolean or null
+				while (pos < end && !CHAR_IS(data[pos], CHAR_DELIMITER)) {
+					++pos;
+				}
+			}
+			if (depth <= 0) {
+				break;
+			}
+		}
+
+		if (pos > end || depth != 0) {
+			parser->position = end;
+			save_error(parser, ERROR_SYNTAX, "Premature end of document while skipping a value.");
+			return;
+		}
+
+		parser->position = pos;
+
+		return;
+	}
+
+	while (1) {
+		char ch = pop(parser);
+
+		if (ch == 0) {
+			save_error(parser, ERROR_SYNTAX, "Premature end of document while skipping a value.");
+			return;
+		} else if (depth == 0 && CHAR_IS(ch, CHAR_SEPARATOR)) {
+			save_error(parser, ERROR_SYNTAX, "Invalid value.");
+			return;
+		} else if (ch == '"') {
+			while ((ch = pop(parser)) != '"') {
+				if (ch == '\\') {
+					ch = pop(parser);
+				}
+				if (ch == 0) {
+					save_error(parser, ERROR_SYNTAX, "Premature end of document while skipping a value.");
+					return;
+				}
+			}
+		} else if (ch == '{' || ch == '[') {
+			++depth;
+			continue;
+		} else if (ch == '}' || ch == ']') {
+			--depth;
+		} else if (depth == 0) {
+			while ((ch = pop(parser)) != 0 && !CHAR_IS(ch, CHAR_DELIMITER)) {
+			}
+			if (ch != 0) {
+				putback(parser);
+			}
+		}
+		if (depth <= 0) {
+			return;
+		}
+	}
+}
+
+//Paths being followed, saved while a child value is parsed
+typedef struct _Selection {
+	int first;
+	int count;
+	int depth;
+	int length;
+} Selection;
+
+static Selection saveSelection(JSONParser *parser) {
+	Selection saved = {parser->selectedFirst, parser->selectedCount,
+		parser->selectedDepth, parser->selectedLength};
+
+	return saved;
+}
+
+static void restoreSelection(JSONParser *parser, Selection saved) {
+	parser->selectedFirst = saved.first;
+	parser->selectedCount = saved.count;
+	parser->selectedDepth = saved.depth;
+	parser->selectedLength = saved.length;
+}
+
+static void pushSelected(JSONParser *parser, int path) {
+	if (parser->selectedLength == parser->selectedCapacity) {
+		parser->selectedCapacity = parser->selectedCapacity == 0 ?
+			64 : parser->selectedCapacity * 2;
+		parser->selected = realloc(parser->selected,
+			parser->selectedCapacity * sizeof(int));
+
+		assert(parser->selected != NULL);
+	}
+
+	parser->selected[parser->selectedLength++] = path;
+}
+
+/*
+ * Starts following every projection path from the root. A count
+ * of -1 means that everything is built.
+ */
+static void beginSelection(JSONParser *parser) {
+	parser->selectedLength = 0;
+	parser->selectedFirst = 0;
+	parser->selectedCount = -1;
+	parser->selectedDepth = 0;
+
+	if (parser->projection == NULL) {
+		return;
+	}
+
+	for (int i = 0; i < parser->projectionLength; ++i) {
+		if (parser->projection[i]->length == 0) {
+			//The whole document is wanted
+			parser->selectedLength = 0;
+
+			return;
+		}
+		pushSelected(parser, i);
+	}
+
+	parser->selectedCount = parser->selectedLength;
+}
+
+/*
+ * Selects the paths that continue into a member with the given name,
+ * or an array item when name is NULL. Returns false if no path does
+ * and the value can be skipped. A scalar is only kept if a path
+ * ends at it.
+ */
+static bool selectChild(JSONParser *parser, const char *name, size_t length, size_t index) {
+	if (parser->selectedCount < 0) {
+		return true;
+	}
+
+	int first = parser->selectedLength;
+	int depth = parser->selectedDepth;
+	bool whole = false;
+
+	for (int i = 0; i < parser->selectedCount; ++i) {
+		int path = parser->selected[parser->selectedFirst + i];
+		JSONPathSegment *s = parser->projection[path]->segments + depth;
+		bool match = s->wildcard || (name != NULL ?
+			s->length == length && memcmp(s->name, name, length) == 0 :
+			s->index >= 0 && (size_t) s->index == index);
+
+		if (!match) {
+			continue;
+		}
+		if (depth + 1 == parser->projection[path]->length) {
+			whole = true;
+			break;
+		}
+		pushSelected(parser, path);
+	}
+
+	if (whole) {
+		parser->selectedLength = first;
+		parser->selectedCount = -1;
+
+		return true;
+	}
+	if (parser->selectedLength == first) {
+		return false;
+	}
+
+	parser->selectedFirst = first;
+	parser->selectedCount = parser->selectedLength - first;
+	parser->selectedDepth = depth + 1;
+
+	eatSpace(parser);
+
+	char ch = peek(parser);
+
+	return ch == '{' || ch == '[';
+}
+
+/*
+ * A container that is being parsed. Open containers are kept on a
+ * stack owned by the parser instead of the C stack.
+ */
+typedef struct _ParseFrame {
+	JSONObject *node;
+	ArenaMark mark;
+	size_t first;
+	size_t textMark;
+	//Name of the member being read. It is in the scratch text at
+	//nameOffset when name is NULL.
+	bool haveName;
+	const char *name;
+	size_t nameOffset;
+	unsigned int nameLength;
+	size_t index;
+	//An array item was just added, ',' or ']' comes next
+	bool afterItem;
+	//Paths followed by the parent, restored when the container is done
+	Selection saved;
+} ParseFrame;
+
+/*
+ * Pushes a frame for the container o. Fails with an error if
+ * that would nest containers deeper than maxDepth.
+ */
+static ParseFrame *pushFrame(JSONParser *parser, JSONObject *o, ArenaMark mark) {
+	if (parser->maxDepth > 0 && parser->frameDepth >= (size_t) parser->maxDepth) {
+		save_error(parser, ERROR_SYNTAX, "Maximum nesting depth exceeded.");
+
+		return NULL;
+	}
+	if (parser->frameDepth == parser->frameCapacity) {
+		parser->frameCapacity = parser->frameCapacity == 0 ?
+			32 : parser->frameCapacity * 2;
+		parser->frames = realloc(parser->frames,
+			parser->frameCapacity * sizeof(ParseFrame));
+
+		assert(parser->frames != NULL);
+	}
+
+	ParseFrame *f = parser->frames + parser->frameDepth++;
+
+	STAT_DEPTH(parser, parser->frameDepth);
+
+	f->node = o;
+	f->mark = mark;
+	f->first = parser->pendingLength;
+	f->textMark = parser->textLength;
+	f->haveName = false;
+	f->name = NULL;
+	f->nameOffset = 0;
+	f->nameLength = 0;
+	f->index = 0;
+	f->afterItem = false;
+
+	return f;
+}
+
+//Called when a value and everything in it has been parsed
+static void valueParsed(JSONParser *parser, JSONObject *o, ArenaMark mark) {
+	STAT_NODE(parser, o);
+	onValueParsed(parser, o);
+	releaseIfCleared(parser, o, mark);
+}
+
+static void addMember(JSONParser *parser, ParseFrame *f, JSONObject *val, ArenaMark mark) {
+	pushPending(parser, f->name, f->nameOffset, f->nameLength, val);
+
+	if (parser->onPropertyParsed != NULL && !parser->lazy) {
+		String *s = parser->propertyName;
+
+		s->length = 0;
+		stringAppendBuffer(s, f->name != NULL ? f->name :
+			parser->text + f->nameOffset, f->nameLength);
+		onPropertyParsed(parser, s, val);
+		releaseIfCleared(parser, val, mark);
+	}
+}
+
+/*
+ * Starts the next value. A scalar is parsed completely. For an object
+ * or array only the opening bracket is read. In arena mode *mark is
+ * set to the arena position right after the value's node, so that
+ * everything below the node can be given back if a callback clears it.
+ */
+static JSONObject *startValue(JSONParser *parser, ArenaMark *mark) {
+	eatSpace(parser);
+
+	char ch = peek(parser);
+
+	FAIL(ch == 0, parser, ERROR_SYNTAX, "Premature end of JSON string.");
+
+	JSONObject *o = newNode(parser, JSON_UNDEFINED);
+
+	if (parser->arena != NULL) {
+		*mark = arenaMark(parser->arena);
+	} else {
+		mark->chunk = NULL;
+		mark->used = 0;
+	}
+
+	if (ch == '"') {
+		parseStringValue(parser, o);
+	} else if (ch == '{') {
+		o->type = JSON_OBJECT;
+		pop(parser);
+	} else if (ch == '[') {
+		o->type = JSON_ARRAY;
+		pop(parser);
+	} else if (CHAR_IS(ch, CHAR_DIGIT) || ch == '-') {
+		parseNumber(parser, o);
+	} else if (ch == 't') {
+		o->type = JSON_BOOLEAN;
+		o->value.booleanValue = parseBool(parser);
+	} else if (ch == 'f') {
+		o->type = JSON_BOOLEAN;
+		o->value.booleanValue = parseBool(parser);
+	} else if (ch == 'n') {
+		o->type = JSON_NULL;
+		o->value.isNull = parseNull(parser);
+	} else {
+		save_error(parser, ERROR_SYNTAX, "Invalid value.");
+	}
+
+	return o;
+}
+
+//A container of a lazy parse
+typedef struct _LazySpan {
+	//Position of the opening bracket and after the closing one
+	size_t start;
+	size_t end;
+	//Number of containers inside, which follow this one in the table
+	size_t count;
+} LazySpan;
+
+/*
+ * Skips over the container at the read position like skipValue() and
+ * adds it and every container inside it to the span table. While a
+ * container is open its count links to the enclosing open one.
+ */
+static void recordSpans(JSONParser *parser) {
+	const char *data = parser->data->buffer;
+	size_t end = parser->data->length;
+	size_t pos = parser->position;
+	size_t open = SIZE_MAX;
+	size_t depth = 0;
+
+	while (pos < end) {
+		char ch = data[pos++];
+
+		if (ch == '"') {
+			while (pos < end && data[pos] != '"') {
+				if (data[pos] == '\\') {
+					++pos;
+				}
+				++pos;
+			}
+			++pos;
+		} else if (ch == '{' || ch == '[') {
+			if (parser->spanLength == parser->spanCapacity) {
+				parser->spanCapacity = parser->spanCapacity == 0 ?
+					64 : parser->spanCapacity * 2;
+				parser->spans = realloc(parser->spans,
+					parser->spanCapacity * sizeof(LazySpan));
+
+				assert(parser->spans != NULL);
+			}
+
+			LazySpan *span = parser->spans + parser->spanLength;
+
+			span->start = pos - 1;
+			span->count = open;
+			open = parser->spanLength++;
+			++depth;
+		} else if (ch == '}' || ch == ']') {
+			LazySpan *span = parser->spans + open;
+
+			open = span->count;
+			span->end = pos;
+			span->count = parser->spanLength - (span - parser->spans) - 1;
+
+			if (--depth == 0) {
+				break;
+			}
+		}
+	}
+
+	if (pos > end || depth != 0) {
+		parser->position = end;
+		save_error(parser, ERROR_SYNTAX, "Premature end of document while skipping a value.");
+		return;
+	}
+
+	parser->position = pos;
+}
+
+/*
+ * In a lazy parse, skips over the container o whose opening bracket
+ * has just been read. The first parse records where the container
+ * and everything in it ends. When the parent is built later its
+ * children are found in the span table instead of being scanned.
+ */
+static bool deferContainer(JSONParser *parser, JSONObject *o) {
+	if (!parser->lazy || (o->type != JSON_OBJECT && o->type != JSON_ARRAY)) {
+		return false;
+	}
+
+	size_t span = parser->spanNext;
+
+	putback(parser);
+
+	if (span == parser->spanLength) {
+		recordSpans(parser);
+	} else {
+		assert(parser->spans[span].start == parser->position);
+
+		parser->position = parser->spans[span].end;
+	}
+	if (parser->errorCode == ERROR_NONE) {
+		parser->spanNext = span + 1 + parser->spans[span].count;
+	}
+
+	o->flags |= JSON_FLAG_LAZY;
+	o->value.lazy.parser = parser;
+	o->value.lazy.span = span;
+
+	return true;
+}
+
+/*
+ * Parses the members of the object at the top of the stack. Returns
+ * true when a child container was pushed, false when the object is done.
+ */
+static bool parseMembers(JSONParser *parser, ParseFrame *f) {
+	while (parser->errorCode == ERROR_NONE) {
+		eatSpace(parser);
+
+		char ch = pop(parser);
+
+		if (ch == 0) {
+			save_error(parser, ERROR_SYNTAX, "Premature end of document while parsing an object.");
+			break;
+		}
 		if (ch == '}') {
 			//End of object
 			break;
-		} else if (ch == '"') {
-			putback(parser);
-			name = parseString(parser);
-		} else if (ch == ':') {
-			JSONObject *val = parseValue(parser);
-			dictionaryPut(d, 
-				stringAsCString(name), val);
-			onPropertyParsed(parser, name, val);
-			deleteString(name);
-			name = NULL;
-		} else if (ch == ',') {
-			//End of a property. Nothing to do here.
-		} else {
-			save_error(parser, ERROR_SYNTAX, "Invalid character in an object.");
+		} else if (ch == '"' && !f->haveName) {
+			putback(parser);
+			f->nameOffset = parser->textLength;
+			f->name = NULL;
+
+			if (zeroCopy(parser)) {
+				size_t length;
+				bool escaped;
+
+				f->haveName = scanStringView(parser, &f->name, &length, &escaped);
+
+				if (f->haveName && parser->inPlace) {
+					f->nameLength = decodeInPlace(parser, f->name, length, escaped);
+				} else if (f->haveName && escaped) {
+					//Decode into the scratch text
+					reserveText(parser, length);
+					parser->textLength += unescapeString(f->name, length,
+						parser->text + f->nameOffset);
+					f->name = NULL;
+				} else {
+					f->nameLength = length;
+				}
+			} else {
+				f->haveName = scanString(parser);
+			}
+			if (f->name == NULL) {
+				f->nameLength = parser->textLength - f->nameOffset;
+			}
+		} else if (ch == ':' && f->haveName) {
+			Selection saved = saveSelection(parser);
+
+			if (!selectChild(parser, f->name != NULL ? f->name :
+				parser->text + f->nameOffset, f->nameLength, -1)) {
+				//Not on a projection path
+				restoreSelection(parser, saved);
+				parser->textLength = f->nameOffset;
+				skipValue(parser);
+				f->haveName = false;
+
+				continue;
+			}
+
+			ArenaMark mark;
+			JSONObject *val = startValue(parser, &mark);
+
+			if (val != NULL && (val->type == JSON_OBJECT || val->type == JSON_ARRAY) &&
+				!deferContainer(parser, val)) {
+				ParseFrame *child = pushFrame(parser, val, mark);
+
+				if (child != NULL) {
+					child->saved = saved;
+
+					return true;
+				}
+			}
+
+			restoreSelection(parser, saved);
+
+			if (val != NULL) {
+				valueParsed(parser, val, mark);
+				addMember(parser, f, val, mark);
+			}
+			f->haveName = false;
+		} else if (ch == ',' && !f->haveName) {
+			//End of a property. Nothing to do here.
+		} else {
+			save_error(parser, ERROR_SYNTAX, "Invalid character in an object.");
+		}
+	}
+
+	return false;
+}
+
+//Reads the ',' or ']' after an array item
+static bool nextItem(JSONParser *parser) {
+	if (parser->errorCode != ERROR_NONE) {
+		return false;
+	}
+
+	eatSpace(parser);
+
+	//Next character must be ',' or ']'
+	char ch = pop(parser);
+
+	if (ch != ',' && ch != ']') {
+		save_error(parser, ERROR_SYNTAX, "Invalid character in array.");
+
+		return false;
+	}
+	if (ch != ',') {
+		putback(parser);
+	}
+
+	return true;
+}
+
+/*
+ * Parses the items of the array at the top of the stack. Returns
+ * true when a child container was pushed, false when the array is done.
+ */
+static bool parseItems(JSONParser *parser, ParseFrame *f) {
+	char ch;
+
+	if (f->afterItem) {
+		f->afterItem = false;
+
+		if (!nextItem(parser)) {
+			return false;
+		}
+	}
+
+	while ((ch = pop(parser)) != ']') {
+		if (ch == 0) {
+			save_error(parser, ERROR_SYNTAX, 
+				"Premature end of documnent while parsing an array.");
+			//Stop parsing array
+			break;
+		}
+		
+		putback(parser);
+
+		Selection saved = saveSelection(parser);
+
+		if (selectChild(parser, NULL, 0, f->index++)) {
+			ArenaMark mark;
+			JSONObject *item = startValue(parser, &mark);
+
+			if (item != NULL && (item->type == JSON_OBJECT || item->type == JSON_ARRAY) &&
+				!deferContainer(parser, item)) {
+				ParseFrame *child = pushFrame(parser, item, mark);
+
+				if (child != NULL) {
+					child->saved = saved;
+
+					return true;
+				}
+			}
+			if (item != NULL) {
+				valueParsed(parser, item, mark);
+				pushPending(parser, NULL, 0, 0, item);
+			} 
+		} else {
+			//Not on a projection path
+			skipValue(parser);
+		}
+
+		restoreSelection(parser, saved);
+
+		if (!nextItem(parser)) {
+			//Stop parsing array
+			break;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Parses everything in the container o, whose opening bracket has
+ * been read. Nested containers are parsed in a loop over the frame
+ * stack, so the depth of a document does not use up the C stack.
+ */
+static void parseContainer(JSONParser *parser, JSONObject *o, ArenaMark mark) {
+	size_t base = parser->frameDepth;
+
+	if (pushFrame(parser, o, mark) == NULL) {
+		return;
+	}
+
+	while (1) {
+		ParseFrame *f = parser->frames + parser->frameDepth - 1;
+		bool object = f->node->type == JSON_OBJECT;
+
+		if (object ? parseMembers(parser, f) : parseItems(parser, f)) {
+			continue;
+		}
+
+		if (object) {
+			closeObject(parser, f->node, f->first, f->textMark);
+		} else {
+			closeArray(parser, f->node, f->first);
+		}
+
+		if (--parser->frameDepth == base) {
+			break;
+		}
+
+		//The container is a value of its parent
+		JSONObject *val = f->node;
+		ArenaMark valMark = f->mark;
+		ParseFrame *parent = f - 1;
+
+		valueParsed(parser, val, valMark);
+		restoreSelection(parser, f->saved);
+
+		if (parent->node->type == JSON_OBJECT) {
+			addMember(parser, parent, val, valMark);
+			parent->haveName = false;
+		} else {
+			pushPending(parser, NULL, 0, 0, val);
+			parent->afterItem = true;
+		}
+	}
+}
+
+//Parses the next value completely
+static JSONObject* parseValue(JSONParser *parser, ArenaMark *mark) {
+	JSONObject *o = startValue(parser, mark);
+
+	if (o == NULL) {
+		return NULL;
+	}
+	if (o->type == JSON_OBJECT || o->type == JSON_ARRAY) {
+		parseContainer(parser, o, *mark);
+	}
+
+	valueParsed(parser, o, *mark);
+
+	return o;
+}
+
+JSONObject *jsonParseCString(JSONParser *parser, const char *stringToParse) {
+	String *str = newStringWithCString(stringToParse);
+	JSONObject *o = jsonParse(parser, str);
+
+	if (parser->zeroCopyStrings) {
+		//Keep the copy until the next parse
+		parser->cStringData = str;
+	} else {
+		deleteString(str);
+	}
+
+	return o;
+}
+
+JSONObject *begin_parse(JSONParser *parser) {
+	beginSelection(parser);
+	eatSpace(parser);
+
+	char ch = peek(parser);
+
+	if (ch == '{' || ch == '[') {
+		ArenaMark mark = {NULL, 0};
+
+		parser->root = newNode(parser, ch == '{' ? JSON_OBJECT : JSON_ARRAY);
+		pop(parser);
+		parseContainer(parser, parser->root, mark);
+		STAT_NODE(parser, parser->root);
+	} else {
+		save_error(parser, ERROR_SYNTAX, "Document does not start with '{' or '['.");
+	}
+
+	return parser->root;
+}
+
+//Smallest part of an array given to a thread
+#define PARALLEL_CHUNK_SIZE (256 * 1024)
+
+//Part of the root array parsed by one worker
+typedef struct _ArrayChunk {
+	JSONParser *worker;
+	size_t start;
+	size_t end;
+	size_t line;
+	pthread_t thread;
+} ArrayChunk;
+
+/*
+ * Finds where the items of the root array can be split for the given
+ * number of chunks. Only commas between items of the root array are
+ * split points. Chunk i runs from after starts[i] to before the next
+ * split point. Returns the number of chunks found, or 0 if the end of
+ * the array was not found.
+ */
+static int splitArray(const char *data, size_t length, size_t open,
+	int count, ArrayChunk *chunks) {
+	size_t target = (length - open) / count;
+	size_t next = open + target;
+	int found = 0;
+	int depth = 0;
+	size_t line = 0;
+
+	for (size_t i = 0; i < open; ++i) {
+		if (data[i] == '\n') {
+			++line;
+		}
+	}
+
+	chunks[0].start = open + 1;
+	chunks[0].line = line;
+
+	for (size_t i = open; i < length; ++i) {
+		char ch = data[i];
+
+		if (ch == '"') {
+			for (++i; i < length && data[i] != '"'; ++i) {
+				if (data[i] == '\\') {
+					++i;
+				} else if (data[i] == '\n') {
+					++line;
+				}
+			}
+		} else if (ch == '[' || ch == '{') {
+			++depth;
+		} else if (ch == ']' || ch == '}') {
+			if (--depth == 0) {
+				chunks[found].end = i;
+
+				return found + 1;
+			}
+		} else if (ch == ',' && depth == 1 && i >= next && found + 1 < count) {
+			chunks[found].end = i;
+			found += 1;
+			chunks[found].start = i + 1;
+			chunks[found].line = line;
+			next = i + target;
+		} else if (ch == '\n') {
+			++line;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Parses the items of the root array up to end into the worker's
+ * root. Runs on its own thread.
+ */
+static void *parseChunk(void *arg) {
+	ArrayChunk *chunk = arg;
+	JSONParser *parser = chunk->worker;
+	size_t first = parser->pendingLength;
+	ArenaMark rootMark = {NULL, 0};
+
+	parser->root = newNode(parser, JSON_ARRAY);
+
+	//The root counts towards the depth of the items
+	pushFrame(parser, parser->root, rootMark);
+
+	while (parser->errorCode == ERROR_NONE) {
+		ArenaMark mark;
+		JSONObject *item = parseValue(parser, &mark);
+
+		if (item != NULL) {
+			pushPending(parser, NULL, 0, 0, item);
+		}
+		if (parser->errorCode != ERROR_NONE) {
+			break;
+		}
+
+		eatSpace(parser);
+
+		if (parser->position >= chunk->end) {
+			break;
+		}
+		if (pop(parser) != ',') {
+			save_error(parser, ERROR_SYNTAX, "Invalid character in array.");
+		}
+	}
+
+	parser->frameDepth = 0;
+	closeArray(parser, parser->root, first);
+
+	return NULL;
+}
+
+static JSONParser *worker(JSONParser *parser, int index) {
+	if (index >= parser->workerCount) {
+		parser->workers = realloc(parser->workers,
+			(index + 1) * sizeof(JSONParser*));
+
+		assert(parser->workers != NULL);
+
+		parser->workers[index] = newJSONParser();
+		parser->workerCount = index + 1;
+	}
+
+	JSONParser *w = parser->workers[index];
+
+	w->arenaChunkSize = parser->arenaChunkSize;
+	w->zeroCopyStrings = parser->zeroCopyStrings;
+	w->parseIntegers = parser->parseIntegers;
+	w->internKeys = parser->internKeys;
+	w->maxDepth = parser->maxDepth;
+
+	return w;
+}
+
+/*
+ * Points the member names below o at the keys of the parser's own
+ * table. The workers of a parallel parse intern names into their own
+ * tables, so keys of the parser would otherwise never match them by
+ * pointer.
+ */
+static void internTree(JSONParser *parser, JSONObject *o) {
+	size_t capacity = 64;
+	size_t count = 0;
+	JSONObject **stack = malloc(capacity * sizeof(JSONObject*));
+
+	assert(stack != NULL);
+
+	stack[count++] = o;
+
+	while (count > 0) {
+		o = stack[--count];
+
+		bool object = o->type == JSON_OBJECT;
+		size_t length = object ? o->value.object.length : o->value.array.length;
+
+		if (count + length > capacity) {
+			while (count + length > capacity) {
+				capacity *= 2;
+			}
+
+			stack = realloc(stack, capacity * sizeof(JSONObject*));
+
+			assert(stack != NULL);
+		}
+
+		for (size_t i = 0; i < length; ++i) {
+			JSONObject *child;
+
+			if (object) {
+				JSONMember *m = o->value.object.members + i;
+
+				m->name = internKey(parser->keys, m->name,
+					m->nameLength, m->hash)->name;
+				child = m->value;
+			} else {
+				child = o->value.array.items[i];
+			}
+			if (child->type == JSON_OBJECT || child->type == JSON_ARRAY) {
+				stack[count++] = child;
+			}
+		}
+	}
+
+	free(stack);
+}
+
+/*
+ * Parses a large root array on several threads. Every thread builds
+ * its items with its own worker parser and the items are then moved
+ * into one root array. The memory of the items stays with the
+ * workers until the next parse. Returns false if the document
+ * should be parsed the normal way.
+ */
+static bool parseParallel(JSONParser *parser) {
+	const char *data = parser->data->buffer;
+	size_t length = parser->data->length;
+	size_t open = 0;
+
+	while (open < length && CHAR_IS(data[open], CHAR_SPACE)) {
+		++open;
+	}
+
+	int count = parser->threads;
+
+	if (length / PARALLEL_CHUNK_SIZE < (size_t) count) {
+		count = length / PARALLEL_CHUNK_SIZE;
+	}
+	if (count < 2 || open >= length || data[open] != '[') {
+		return false;
+	}
+
+	ArrayChunk chunks[count];
+
+	count = splitArray(data, length, open, count, chunks);
+
+	if (count < 2) {
+		//Unterminated or too few items, let the parser find out
+		return false;
+	}
+
+	for (int i = 0; i < count; ++i) {
+		JSONParser *w = worker(parser, i);
+
+		clearParser(w);
+		w->data = parser->data;
+		//The chunks do not overlap
+		w->inPlace = parser->inPlace;
+		w->position = chunks[i].start;
+		w->errorLine = chunks[i].line;
+		w->lineOffset = chunks[i].start;
+		chunks[i].worker = w;
+
+		int status = pthread_create(&chunks[i].thread, NULL, parseChunk, chunks + i);
+
+		assert(status == 0);
+	}
+
+	size_t total = 0;
+
+	for (int i = 0; i < count; ++i) {
+		JSONParser *w = chunks[i].worker;
+
+		pthread_join(chunks[i].thread, NULL);
+
+		if (w->errorCode != ERROR_NONE && parser->errorCode == ERROR_NONE) {
+			parser->errorCode = w->errorCode;
+			parser->errorMessage = w->errorMessage;
+			parser->errorLine = w->errorLine;
+		}
+
+		total += w->root->value.array.length;
+#ifdef JAPP_STATS
+		jsonAddStats(&parser->stats, &w->stats);
+#endif
+	}
+
+	JSONObject *root = newNode(parser, JSON_ARRAY);
+	JSONObject **items = total > 0 ?
+		allocBlock(parser, total * sizeof(JSONObject*)) : NULL;
+	size_t next = 0;
+
+	for (int i = 0; i < count; ++i) {
+		JSONObject *part = chunks[i].worker->root;
+
+		if (part->value.array.length > 0) {
+			memcpy(items + next, part->value.array.items,
+				part->value.array.length * sizeof(JSONObject*));
+			next += part->value.array.length;
+
+			//The root owns the items now
+			if ((part->flags & JSON_FLAG_ARENA) == 0) {
+				free(part->value.array.items);
+			}
+			part->value.array.items = NULL;
+			part->value.array.length = 0;
+		}
+	}
+
+	root->value.array.items = items;
+	root->value.array.length = total;
+	parser->root = root;
+	parser->position = chunks[count - 1].worker->position;
+
+	if (parser->internKeys) {
+		internTree(parser, root);
+	}
+	STAT_NODE(parser, root);
+
+	return true;
+}
+
+#ifdef JAPP_STATS
+//Completes the statistics at the end of a call to the parser
+static void endStats(JSONParser *parser, double started) {
+	JSONParserStats *s = &parser->stats;
+	size_t memory = s->allocatedBytes + parser->textCapacity +
+		parser->pendingCapacity * sizeof(JSONPendingMember) +
+		parser->frameCapacity * sizeof(ParseFrame) +
+		parser->streamBufferCapacity +
+		parser->spanCapacity * sizeof(LazySpan) +
+		parser->selectedCapacity * sizeof(int);
+
+	if (parser->streamFd < 0) {
+		//A stream counts the bytes as they are read
+		s->bytes = parser->position;
+	}
+	if (memory > s->peakMemory) {
+		s->peakMemory = memory;
+	}
+
+	s->totalSeconds += statsClock() - started;
+}
+
+#define STAT_END(p, started) endStats(p, started)
+#else
+#define STAT_END(p, started)
+#endif
+
+/*
+ * Validates a whole in-memory document when validateUTF8 is set.
+ * The error line is the one of the first invalid byte.
+ */
+static bool checkUTF8(JSONParser *parser, String *data) {
+	if (!parser->validateUTF8) {
+		return true;
+	}
+
+	size_t valid = validateUTF8(data->buffer, data->length, &parser->utf8State);
+
+	if (valid == data->length && parser->utf8State == UTF8_ACCEPT) {
+		return true;
+	}
+
+	parser->position = valid;
+	save_error(parser, ERROR_SYNTAX, "Invalid UTF-8 in document.");
+
+	return false;
+}
+
+//Parses an in-memory document. The parser must have been cleared.
+static JSONObject *parseData(JSONParser *parser, String *stringToParse) {
+	parser->data = stringToParse;
+
+	if (!checkUTF8(parser, stringToParse)) {
+		return NULL;
+	}
+
+	if (parser->threads > 1 && parser->projection == NULL &&
+		parser->onValueParsed == NULL && parser->onPropertyParsed == NULL &&
+		parseParallel(parser)) {
+		return parser->root;
+	}
+
+	return begin_parse(parser);
+}
+
+JSONObject *jsonParse(JSONParser *parser, String *stringToParse) {
+	STAT_START(started);
+
+	clearParser(parser);
+	parseData(parser, stringToParse);
+	STAT_END(parser, started);
+
+	return parser->root;
+}
+
+JSONObject *jsonParseLazy(JSONParser *parser, String *stringToParse) {
+	STAT_START(started);
+
+	clearParser(parser);
+
+	parser->data = stringToParse;
+	parser->lazy = true;
+
+	if (checkUTF8(parser, stringToParse)) {
+		//Paths are not followed into containers built later
+		JSONPath **projection = parser->projection;
+
+		parser->projection = NULL;
+		begin_parse(parser);
+		parser->projection = projection;
+	}
+
+	STAT_END(parser, started);
+
+	return parser->root;
+}
+
+JSONObject *jsonParseInPlace(JSONParser *parser, char *buffer, size_t length) {
+	STAT_START(started);
+
+	clearParser(parser);
+
+	if (parser->inPlaceData == NULL) {
+		parser->inPlaceData = malloc(sizeof(String));
+
+		assert(parser->inPlaceData != NULL);
+	}
+
+	parser->inPlaceData->buffer = buffer;
+	parser->inPlaceData->length = length;
+	parser->inPlaceData->capacity = length;
+	parser->inPlace = true;
+
+	parseData(parser, parser->inPlaceData);
+	STAT_END(parser, started);
+
+	return parser->root;
+}
+
+/*
+ * Builds the members or items of a container of a lazy parse. Nested
+ * containers are deferred again. After an error nothing more is built.
+ */
+void jsonExpand(JSONObject *o) {
+	if ((o->flags & JSON_FLAG_LAZY) == 0) {
+		return;
+	}
+
+	JSONParser *parser = o->value.lazy.parser;
+	size_t span = o->value.lazy.span;
+	ArenaMark mark = {NULL, 0};
+
+	o->flags &= ~JSON_FLAG_LAZY;
+	memset(&o->value, 0, sizeof(o->value));
+
+	if (parser->errorCode != ERROR_NONE) {
+		return;
+	}
+
+	assert(parser->lazy && parser->frameDepth == 0);
+
+	//Continue after the opening bracket. The containers inside follow
+	//this one in the span table.
+	parser->position = parser->spans[span].start + 1;
+	parser->spanNext = span + 1;
+	parser->errorLine = 0;
+	parser->lineOffset = 0;
+	parseContainer(parser, o, mark);
+}
+
+static void beginStream(JSONParser *parser, int streamFd) {
+	clearParser(parser);
+
+	if (parser->streamBufferSize == 0) {
+		parser->streamBufferSize = JSON_STREAM_BUFFER_SIZE;
+	}
+	if (parser->streamBufferCapacity != parser->streamBufferSize) {
+		free(parser->streamBuffer);
+		parser->streamBuffer = malloc(parser->streamBufferSize);
+
+		assert(parser->streamBuffer != NULL);
+
+		parser->streamBufferCapacity = parser->streamBufferSize;
+	}
+
+	parser->streamFd = streamFd;
+}
+
+JSONObject *jsonParseStream(JSONParser *parser, int streamFd) {
+	STAT_START(started);
+
+	beginStream(parser, streamFd);
+	begin_parse(parser);
+	STAT_END(parser, started);
+
+	return parser->root;
+}
+
+/*
+ * Parses a file straight from a memory mapping of it. The mapping
+ * is kept until the parser is cleared, so zero copy strings can
+ * point into it. Files that can not be mapped are read as a stream.
+ */
+JSONObject *jsonParseFile(JSONParser *parser, const char *path) {
+	size_t length;
+	int fd;
+	STAT_START(started);
+
+	clearParser(parser);
+
+	const char *data = mapFile(path, &length, &fd);
+
+	STAT_TIME(parser, readSeconds, started);
+
+	if (data == NULL) {
+		if (fd < 0) {
+			save_error(parser, ERROR_IO, "Failed to open file.");
+
+			return NULL;
+		}
+
+		JSONObject *o = jsonParseStream(parser, fd);
+
+		close(fd);
+
+		return o;
+	}
+
+	if (parser->mappedData == NULL) {
+		parser->mappedData = malloc(sizeof(String));
+
+		assert(parser->mappedData != NULL);
+	}
+
+	parser->mappedData->buffer = (char*) data;
+	parser->mappedData->length = length;
+	parser->mappedData->capacity = length;
+
+	parseData(parser, parser->mappedData);
+	STAT_END(parser, started);
+
+	return parser->root;
+}
+
+//Pull tokenizer states
+#define TOKEN_ROOT 0 //Expecting the root object or array
+#define TOKEN_VALUE 1 //Expecting a value
+#define TOKEN_KEY 2 //Expecting a property name
+#define TOKEN_FIRST_KEY 3 //After '{'
+#define TOKEN_FIRST_ITEM 4 //After '['
+#define TOKEN_NEXT 5 //After a value, expecting ',' or the end of a container
+#define TOKEN_DONE 6
+
+void jsonBeginTokens(JSONParser *parser, String *stringToParse) {
+	clearParser(parser);
+
+	parser->data = stringToParse;
+	checkUTF8(parser, stringToParse);
+}
+
+void jsonBeginTokenStream(JSONParser *parser, int streamFd) {
+	beginStream(parser, streamFd);
+}
+
+static JSONTokenType tokenError(JSONParser *parser, JSONToken *token, const char *msg) {
+	save_error(parser, ERROR_SYNTAX, msg);
+
+	return token->type = JSON_TOKEN_ERROR;
+}
+
+static JSONTokenType openToken(JSONParser *parser, JSONToken *token, char ch) {
+	if (parser->maxDepth > 0 && parser->tokenDepth >= parser->maxDepth) {
+		return tokenError(parser, token, "Maximum nesting depth exceeded.");
+	}
+	if (parser->tokenDepth == parser->tokenStackCapacity) {
+		parser->tokenStackCapacity = parser->tokenStackCapacity == 0 ?
+			64 : parser->tokenStackCapacity * 2;
+		parser->tokenStack = realloc(parser->tokenStack,
+			parser->tokenStackCapacity);
+
+		assert(parser->tokenStack != NULL);
+	}
+
+	parser->tokenStack[parser->tokenDepth++] = ch;
+
+	if (ch == '{') {
+		parser->tokenState = TOKEN_FIRST_KEY;
+
+		return token->type = JSON_TOKEN_START_OBJECT;
+	}
+
+	parser->tokenState = TOKEN_FIRST_ITEM;
+
+	return token->type = JSON_TOKEN_START_ARRAY;
+}
+
+static JSONTokenType valueToken(JSONParser *parser, JSONToken *token, JSONTokenType type) {
+	parser->tokenState = parser->tokenDepth == 0 ? TOKEN_DONE : TOKEN_NEXT;
+
+	return token->type = type;
+}
+
+static JSONTokenType closeToken(JSONParser *parser, JSONToken *token, char ch) {
+	parser->tokenDepth -= 1;
+
+	return valueToken(parser, token,
+		ch == '}' ? JSON_TOKEN_END_OBJECT : JSON_TOKEN_END_ARRAY);
+}
+
+/*
+ * Reads a string into the token. In memory a string without escape
+ * sequences is not copied.
+ */
+static bool stringToken(JSONParser *parser, JSONToken *token) {
+	if (parser->streamFd < 0) {
+		const char *start;
+		size_t length;
+		bool escaped;
+
+		if (!scanStringView(parser, &start, &length, &escaped)) {
+			return false;
 		}
-		if (parser->errorCode != ERROR_NONE) {
-			break;
+		if (escaped) {
+			reserveText(parser, length);
+			length = unescapeString(start, length, parser->text);
+			start = parser->text;
 		}
+
+		token->string = start;
+		token->length = length;
+
+		return true;
 	}
 
-	return o;
+	if (!scanString(parser)) {
+		return false;
+	}
+
+	token->string = parser->text;
+	token->length = parser->textLength;
+
+	return true;
+}
+
+//Reads the rest of true, false or null
+static bool literalToken(JSONParser *parser, const char *word) {
+	for (const char *c = word + 1; *c != '\0'; ++c) {
+		if (pop(parser) != *c) {
+			return false;
+		}
+	}
+
+	return !isalnum((unsigned char) peek(parser));
 }
 
-static Array* parseArray(JSONParser *parser) {
+JSONTokenType jsonNextToken(JSONParser *parser, JSONToken *token) {
+	token->type = JSON_TOKEN_ERROR;
+	token->flags = 0;
+	token->string = NULL;
+	token->length = 0;
+
+	if (parser->errorCode != ERROR_NONE) {
+		return JSON_TOKEN_ERROR;
+	}
+	if (parser->tokenState == TOKEN_DONE) {
+		return token->type = JSON_TOKEN_END;
+	}
+
+	parser->textLength = 0;
+
 	eatSpace(parser);
 
 	char ch = pop(parser);
 
-	FAIL(ch == 0, parser, ERROR_SYNTAX, "Premature end of documnent while parsing an array.");
-	FAIL(ch != '[', parser, ERROR_SYNTAX, "JSON array does not start with '['.");
+	if (ch == 0) {
+		return tokenError(parser, token, "Premature end of document.");
+	}
 
-	Array *a = newArray(25);
+	int state = parser->tokenState;
 
-	while ((ch = pop(parser)) != ']') {
-		if (ch == 0) {
-			deleteArray(a);
-			a = NULL;
-			save_error(parser, ERROR_SYNTAX, 
-				"Premature end of documnent while parsing an array.");
-			//Stop parsing array
-			break;
+	if (state == TOKEN_ROOT) {
+		if (ch != '{' && ch != '[') {
+			return tokenError(parser, token,
+				"Document does not start with '{' or '['.");
 		}
-		
-		putback(parser);
+		state = TOKEN_VALUE;
+	} else if (state == TOKEN_NEXT) {
+		char open = parser->tokenStack[parser->tokenDepth - 1];
 
-		JSONObject *o = parseValue(parser);
-		if (o != NULL) {
-			arrayAdd(a, o);
-		} 
-		eatSpace(parser);
-		//Next character must be ',' or ']'
-		ch = pop(parser);
-		if (ch != ',' && ch != ']') {
-			deleteArray(a);
-			a = NULL;
-			save_error(parser, ERROR_SYNTAX, "Invalid character in array.");
-			//Stop parsing array
-			break;
+		if (ch == (open == '{' ? '}' : ']')) {
+			return closeToken(parser, token, ch);
 		}
 		if (ch != ',') {
-			putback(parser);
+			return tokenError(parser, token, open == '{' ?
+				"Invalid character in an object." :
+				"Invalid character in array.");
+		}
+
+		state = open == '{' ? TOKEN_KEY : TOKEN_VALUE;
+
+		eatSpace(parser);
+		ch = pop(parser);
+	} else if (state == TOKEN_FIRST_KEY || state == TOKEN_FIRST_ITEM) {
+		if (ch == (state == TOKEN_FIRST_KEY ? '}' : ']')) {
+			return closeToken(parser, token, ch);
 		}
+
+		state = state == TOKEN_FIRST_KEY ? TOKEN_KEY : TOKEN_VALUE;
 	}
 
-	return a;
-}
+	if (ch == 0) {
+		return tokenError(parser, token, "Premature end of document.");
+	}
 
-static JSONObject* parseValue(JSONParser *parser) {
-	JSONObject *o = NULL;
+	if (state == TOKEN_KEY) {
+		if (ch != '"') {
+			return tokenError(parser, token, "Invalid character in an object.");
+		}
 
-	eatSpace(parser);
+		putback(parser);
 
-	char ch = peek(parser);
+		if (!stringToken(parser, token)) {
+			return JSON_TOKEN_ERROR;
+		}
 
-	FAIL(ch == 0, parser, ERROR_SYNTAX, "Premature end of JSON string.");
+		eatSpace(parser);
 
-	if (ch == '"') {
-		String *str = parseString(parser);
+		if (pop(parser) != ':') {
+			return tokenError(parser, token, "Invalid character in an object.");
+		}
 
-		o = newJSONObject(JSON_STRING);
-		o->value.string = str;
-	} else if (ch == '{') {
-		o = parseObject(parser);
-	} else if (ch == '[') {
-		Array *a = parseArray(parser);
+		parser->tokenState = TOKEN_VALUE;
 
-		o = newJSONObject(JSON_ARRAY);
-		o->value.array = a;
-	} else if (isdigit(ch) || ch == '-') {
-		o = newJSONObject(JSON_NUMBER);
-		o->value.number = parseNumber(parser);
-	} else if (ch == 't') {
-		o = newJSONObject(JSON_BOOLEAN);
-		o->value.booleanValue = parseBool(parser);
-	} else if (ch == 'f') {
-		o = newJSONObject(JSON_BOOLEAN);
-		o->value.booleanValue = parseBool(parser);
+		return token->type = JSON_TOKEN_KEY;
+	}
+
+	if (ch == '{' || ch == '[') {
+		return openToken(parser, token, ch);
+	} else if (ch == '"') {
+		putback(parser);
+
+		if (!stringToken(parser, token)) {
+			return JSON_TOKEN_ERROR;
+		}
+
+		return valueToken(parser, token, JSON_TOKEN_STRING);
+	} else if (ch == 't' || ch == 'f') {
+		if (!literalToken(parser, ch == 't' ? "true" : "false")) {
+			return tokenError(parser, token, "Invalid boolean value.");
+		}
+
+		token->value.booleanValue = ch == 't';
+
+		return valueToken(parser, token, JSON_TOKEN_BOOLEAN);
 	} else if (ch == 'n') {
-		o = newJSONObject(JSON_NULL);
-		o->value.isNull = parseNull(parser);
+		if (!literalToken(parser, "null")) {
+			return tokenError(parser, token, "Invalid null value.");
+		}
+
+		return valueToken(parser, token, JSON_TOKEN_NULL);
+	} else if (CHAR_IS(ch, CHAR_DIGIT) || ch == '-') {
+		Number n;
+
+		putback(parser);
+
+		if (!scanNumberValue(parser, &n)) {
+			return JSON_TOKEN_ERROR;
+		}
+
+		if (n.kind == NUMBER_DOUBLE || !parser->parseIntegers) {
+			token->value.number = n.kind == NUMBER_DOUBLE ? n.value.d :
+				n.kind == NUMBER_INTEGER ? (double) n.value.i :
+				(double) n.value.u;
+
+			return valueToken(parser, token, JSON_TOKEN_NUMBER);
+		}
+
+		token->value.unsignedInteger = n.value.u;
+
+		if (n.kind == NUMBER_UNSIGNED) {
+			token->flags |= JSON_FLAG_UNSIGNED;
+		}
+
+		return valueToken(parser, token, JSON_TOKEN_INTEGER);
 	}
 
-	onValueParsed(parser, o);
+	return tokenError(parser, token, "Invalid value.");
+}
 
-	return o;
+//Push parser states. Whitespace is skipped in all states below FEED_STRING.
+#define FEED_IDLE 0 //jsonBeginFeed() has not been called
+#define FEED_ROOT 1 //Expecting the root object or array
+#define FEED_VALUE 2 //Expecting a value
+#define FEED_FIRST_KEY 3 //After '{'
+#define FEED_KEY 4 //After ',' in an object
+#define FEED_COLON 5 //After a property name
+#define FEED_FIRST_ITEM 6 //After '['
+#define FEED_NEXT 7 //After a value, expecting ',' or the end of a container
+#define FEED_STRING 8 //Inside a string
+#define FEED_ESCAPE 9 //After '\' in a string
+#define FEED_UNICODE 10 //Inside a \u escape
+#define FEED_NUMBER 11
+#define FEED_LITERAL 12 //Inside true, false or null
+#define FEED_DONE 13
+
+void jsonBeginFeed(JSONParser *parser) {
+	clearParser(parser);
+
+	parser->feedState = FEED_ROOT;
 }
 
-JSONObject *jsonParseCString(JSONParser *parser, const char *stringToParse) {
-	String *str = newStringWithCString(stringToParse);
-	JSONObject *o = jsonParse(parser, str);
+/*
+ * Allocates the node for a value and sets *mark to the arena
+ * position right after it, like parseValue() does.
+ */
+static JSONObject *feedNode(JSONParser *parser, JSONType type, ArenaMark *mark) {
+	JSONObject *o = newNode(parser, type);
 
-	deleteString(str);
+	if (parser->arena != NULL) {
+		*mark = arenaMark(parser->arena);
+	} else {
+		mark->chunk = NULL;
+		mark->used = 0;
+	}
 
 	return o;
 }
 
-JSONObject *begin_parse(JSONParser *parser) {
-	eatSpace(parser);
+//Adds a finished value to the innermost open container
+static void feedValue(JSONParser *parser, JSONObject *o, ArenaMark mark) {
+	ParseFrame *f = parser->frames + parser->frameDepth - 1;
 
-	char ch = peek(parser);
+	STAT_NODE(parser, o);
+	onValueParsed(parser, o);
+	releaseIfCleared(parser, o, mark);
 
-	if (ch == '{') {
-		parser->root = parseObject(parser);
-	} else if (ch == '[') {
-		Array *a = parseArray(parser);
-		JSONObject *o = newJSONObject(JSON_ARRAY);
-		o->value.array = a;
+	parser->feedState = FEED_NEXT;
+
+	if (f->node->type == JSON_ARRAY) {
+		pushPending(parser, NULL, 0, 0, o);
+
+		return;
+	}
+
+	pushPending(parser, NULL, f->nameOffset, f->nameLength, o);
+
+	if (parser->onPropertyParsed != NULL) {
+		String *s = parser->propertyName;
+
+		s->length = 0;
+		stringAppendBuffer(s, parser->text + f->nameOffset, f->nameLength);
+		onPropertyParsed(parser, s, o);
+		releaseIfCleared(parser, o, mark);
+	}
+}
+
+static void feedOpen(JSONParser *parser, char ch) {
+	ArenaMark mark;
+	JSONObject *o = feedNode(parser, ch == '{' ? JSON_OBJECT : JSON_ARRAY, &mark);
 
+	if (parser->frameDepth == 0) {
 		parser->root = o;
+	}
+
+	if (pushFrame(parser, o, mark) == NULL) {
+		//Too deep. The empty container is still added to its parent.
+		feedValue(parser, o, mark);
+		unwindFeed(parser);
+
+		return;
+	}
+
+	parser->feedState = ch == '{' ? FEED_FIRST_KEY : FEED_FIRST_ITEM;
+}
+
+//Closes the innermost container. Returns it, or NULL if it is the root.
+static JSONObject *feedClose(JSONParser *parser, ArenaMark *mark) {
+	ParseFrame *f = parser->frames + --parser->frameDepth;
+
+	if (f->node->type == JSON_OBJECT) {
+		closeObject(parser, f->node, f->first, f->textMark);
 	} else {
-		save_error(parser, ERROR_SYNTAX, "Document does not start with '{' or '['.");
+		closeArray(parser, f->node, f->first);
 	}
 
-	return parser->root;
+	*mark = f->mark;
+
+	return parser->frameDepth > 0 ? f->node : NULL;
 }
 
-JSONObject *jsonParse(JSONParser *parser, String *stringToParse) {
-	clearParser(parser);
+/*
+ * Closes all open containers so that whatever was parsed is part of
+ * the root and is freed with it.
+ */
+static void unwindFeed(JSONParser *parser) {
+	while (parser->frameDepth > 0) {
+		ArenaMark mark;
+		JSONObject *o = feedClose(parser, &mark);
 
-	parser->data = stringToParse;
+		if (o != NULL) {
+			ParseFrame *f = parser->frames + parser->frameDepth - 1;
 
-	return begin_parse(parser);
+			pushPending(parser, NULL, f->nameOffset,
+				f->node->type == JSON_OBJECT ? f->nameLength : 0, o);
+		}
+	}
 }
 
-JSONObject *jsonParseStream(JSONParser *parser, int streamFd) {
-	clearParser(parser);
+static void feedError(JSONParser *parser, const char *msg) {
+	save_error(parser, ERROR_SYNTAX, msg);
+	unwindFeed(parser);
+}
 
-	parser->streamFd = streamFd;
+//Called at the closing quote of a string
+static void feedString(JSONParser *parser) {
+	parser->feedHigh = 0;
 
-	return begin_parse(parser);
+	if (parser->feedKey) {
+		ParseFrame *f = parser->frames + parser->frameDepth - 1;
+
+		//The name stays in the scratch text until the object is closed
+		f->nameOffset = parser->feedOffset;
+		f->nameLength = parser->textLength - parser->feedOffset;
+		parser->feedState = FEED_COLON;
+
+		return;
+	}
+
+	ArenaMark mark;
+	JSONObject *o = feedNode(parser, JSON_STRING, &mark);
+
+	o->value.string = newStringFromText(parser, parser->feedOffset);
+	feedValue(parser, o, mark);
+}
+
+//Called at the first character after a number
+static void feedNumber(JSONParser *parser) {
+	const char *start = parser->text + parser->feedOffset;
+	size_t count = parser->textLength - parser->feedOffset;
+	Number n;
+
+	parser->textLength = parser->feedOffset;
+
+	if (scanNumber(start, start + count, &n) != count) {
+		feedError(parser, "Failed to parse number.");
+
+		return;
+	}
+
+	ArenaMark mark;
+	JSONObject *o = feedNode(parser, JSON_UNDEFINED, &mark);
+
+	setNumber(parser, o, n);
+	feedValue(parser, o, mark);
+}
+
+static void feedLiteral(JSONParser *parser) {
+	ArenaMark mark;
+	JSONObject *o;
+
+	if (parser->feedLiteral[0] == 'n') {
+		o = feedNode(parser, JSON_NULL, &mark);
+		o->value.isNull = true;
+	} else {
+		o = feedNode(parser, JSON_BOOLEAN, &mark);
+		o->value.booleanValue = parser->feedLiteral[0] == 't';
+	}
+
+	feedValue(parser, o, mark);
+}
+
+//Handles one character outside of strings, numbers and literals
+static void feedStructural(JSONParser *parser, char ch) {
+	int state = parser->feedState;
+
+	if (state == FEED_ROOT) {
+		if (ch == '{' || ch == '[') {
+			feedOpen(parser, ch);
+		} else {
+			feedError(parser, "Document does not start with '{' or '['.");
+		}
+
+		return;
+	}
+
+	if (state == FEED_NEXT) {
+		ParseFrame *f = parser->frames + parser->frameDepth - 1;
+		bool object = f->node->type == JSON_OBJECT;
+
+		if (ch == ',') {
+			parser->feedState = object ? FEED_KEY : FEED_VALUE;
+
+			return;
+		}
+		if (ch != (object ? '}' : ']')) {
+			feedError(parser, object ? "Invalid character in an object." :
+				"Invalid character in array.");
+
+			return;
+		}
+
+		state = object ? FEED_FIRST_KEY : FEED_FIRST_ITEM;
+	}
+
+	if ((state == FEED_FIRST_KEY && ch == '}') ||
+		(state == FEED_FIRST_ITEM && ch == ']')) {
+		ArenaMark mark;
+		JSONObject *o = feedClose(parser, &mark);
+
+		if (o != NULL) {
+			feedValue(parser, o, mark);
+		} else {
+			STAT_NODE(parser, parser->root);
+			parser->feedState = FEED_DONE;
+		}
+
+		return;
+	}
+
+	if (state == FEED_FIRST_KEY || state == FEED_KEY) {
+		if (ch != '"') {
+			feedError(parser, "Invalid character in an object.");
+
+			return;
+		}
+
+		parser->feedKey = true;
+		parser->feedOffset = parser->textLength;
+		parser->feedState = FEED_STRING;
+
+		return;
+	}
+
+	if (state == FEED_COLON) {
+		if (ch != ':') {
+			feedError(parser, "Invalid character in an object.");
+
+			return;
+		}
+
+		parser->feedState = FEED_VALUE;
+
+		return;
+	}
+
+	//A value
+	if (ch == '{' || ch == '[') {
+		feedOpen(parser, ch);
+	} else if (ch == '"') {
+		parser->feedKey = false;
+		parser->feedOffset = parser->textLength;
+		parser->feedState = FEED_STRING;
+	} else if (ch == 't' || ch == 'f' || ch == 'n') {
+		parser->feedLiteral = ch == 't' ? "true" : ch == 'f' ? "false" : "null";
+		parser->feedMatched = 1;
+		parser->feedState = FEED_LITERAL;
+	} else if (CHAR_IS(ch, CHAR_DIGIT) || ch == '-') {
+		parser->feedOffset = parser->textLength;
+		parser->feedState = FEED_NUMBER;
+		appendTextChar(parser, ch);
+	} else {
+		feedError(parser, "Invalid value.");
+	}
+}
+
+//Handles the character after '\' in a string
+static void feedEscape(JSONParser *parser, char ch) {
+	parser->feedState = FEED_STRING;
+
+	switch (ch) {
+	case 't': ch = '\t'; break;
+	case 'r': ch = '\r'; break;
+	case 'n': ch = '\n'; break;
+	case 'b': ch = '\b'; break;
+	case 'f': ch = '\f'; break;
+	case '"': case '\\': case '/': break;
+	case 'u':
+		parser->feedHexLength = 0;
+		parser->feedState = FEED_UNICODE;
+
+		return;
+	default:
+		feedError(parser, "Invalid escaped character in string.");
+
+		return;
+	}
+
+	appendTextChar(parser, ch);
+	parser->feedHigh = 0;
+}
+
+static void feedUnicode(JSONParser *parser, char ch) {
+	parser->feedHex[parser->feedHexLength++] = ch;
+
+	if (parser->feedHexLength < 4) {
+		return;
+	}
+
+	parser->feedHex[4] = '\0';
+
+	int unicode = hexValue(parser->feedHex);
+
+	if (unicode < 0) {
+		feedError(parser, "Invalid escaped character in string.");
+
+		return;
+	}
+
+	reserveText(parser, 4);
+	parser->textLength += decodeEscape(unicode, &parser->feedHigh,
+		parser->text + parser->textLength);
+	parser->feedState = FEED_STRING;
+}
+
+/*
+ * Parses the next piece of a document. Strings, numbers and escape
+ * sequences may be split anywhere across calls.
+ */
+JSONFeedStatus jsonParserFeed(JSONParser *parser, const char *buffer, size_t length) {
+	STAT_START(started);
+
+	assert(parser->feedState != FEED_IDLE);
+
+	parser->feedConsumed = 0;
+
+	if (parser->errorCode != ERROR_NONE) {
+		return JSON_FEED_ERROR;
+	}
+	if (parser->feedState == FEED_DONE) {
+		return JSON_FEED_DONE;
+	}
+	if (length == 0) {
+		feedError(parser, "Premature end of document.");
+
+		return JSON_FEED_ERROR;
+	}
+
+	const char *c = buffer;
+	//Only the bytes before an invalid one are parsed
+	const char *end = buffer + (parser->validateUTF8 ?
+		validateUTF8(buffer, length, &parser->utf8State) : length);
+
+	while (c < end && parser->feedState != FEED_DONE &&
+		parser->errorCode == ERROR_NONE) {
+		char ch = *c;
+		int state = parser->feedState;
+
+		if (state == FEED_STRING) {
+			//Copy a run of plain characters in one go
+			const char *run = c;
+
+			while (c < end && *c != '"' && *c != '\\') {
+				if (*c == '\n') {
+					parser->errorLine += 1;
+				}
+				++c;
+			}
+
+			reserveText(parser, c - run);
+			memcpy(parser->text + parser->textLength, run, c - run);
+			parser->textLength += c - run;
+
+			if (c > run) {
+				parser->feedHigh = 0;
+			}
+
+			if (c == end) {
+				break;
+			}
+			if (*c++ == '"') {
+				feedString(parser);
+			} else {
+				parser->feedState = FEED_ESCAPE;
+			}
+
+			continue;
+		}
+
+		if (state < FEED_STRING && CHAR_IS(ch, CHAR_SPACE)) {
+			if (ch == '\n') {
+				parser->errorLine += 1;
+			}
+			++c;
+
+			continue;
+		}
+
+		if (state == FEED_NUMBER) {
+			if (!isNumberChar(ch)) {
+				//The character is looked at again after the number
+				feedNumber(parser);
+
+				continue;
+			}
+			appendTextChar(parser, ch);
+		} else if (state == FEED_LITERAL) {
+			if (ch != parser->feedLiteral[parser->feedMatched]) {
+				feedError(parser, parser->feedLiteral[0] == 'n' ?
+					"Invalid null value." : "Invalid boolean value.");
+
+				break;
+			}
+			if (parser->feedLiteral[++parser->feedMatched] == '\0') {
+				feedLiteral(parser);
+			}
+		} else if (state == FEED_ESCAPE) {
+			feedEscape(parser, ch);
+		} else if (state == FEED_UNICODE) {
+			feedUnicode(parser, ch);
+		} else {
+			feedStructural(parser, ch);
+		}
+
+		if (parser->errorCode != ERROR_NONE) {
+			break;
+		}
+		++c;
+	}
+
+	if (c < buffer + length && parser->feedState != FEED_DONE &&
+		parser->errorCode == ERROR_NONE) {
+		feedError(parser, "Invalid UTF-8 in document.");
+	}
+
+	parser->feedConsumed = c - buffer;
+	parser->position += c - buffer;
+	STAT_END(parser, started);
+
+	if (parser->errorCode != ERROR_NONE) {
+		return JSON_FEED_ERROR;
+	}
+
+	return parser->feedState == FEED_DONE ? JSON_FEED_DONE : JSON_FEED_NEED_MORE;
 }
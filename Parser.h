@@ -1,14 +1,20 @@
 #include <stdbool.h>
+#include <stdint.h>
 #include "../Cute/String.h"
-#include "../Cute/Dictionary.h"
-#include "../Cute/Array.h"
 
 typedef enum _ErrorCode {
 	ERROR_NONE,
 	ERROR_INVALID_TYPE,
-	ERROR_SYNTAX
+	ERROR_SYNTAX,
+	ERROR_IO
 } ErrorCode;
 
+//Default size of the refill buffer used by jsonParseStream
+#define JSON_STREAM_BUFFER_SIZE (64 * 1024)
+
+//Default deepest nesting of objects and arrays accepted by a parser
+#define JSON_MAX_DEPTH 1024
+
 typedef enum _JSONType {
 	JSON_UNDEFINED,
 	JSON_STRING,
@@ -16,65 +22,602 @@ typedef enum _JSONType {
 	JSON_OBJECT,
 	JSON_ARRAY,
 	JSON_BOOLEAN,
-	JSON_NULL
+	JSON_NULL,
+	JSON_INTEGER
 } JSONType;
 
+#define JSON_TYPE_COUNT (JSON_INTEGER + 1)
+
+//JSONObject flags
+#define JSON_FLAG_ARENA 0x1 //Memory is owned by a parser arena
+#define JSON_FLAG_VIEW 0x2 //String value is a view into the parsed data
+#define JSON_FLAG_ESCAPED 0x4 //String view contains escape sequences
+#define JSON_FLAG_UNSIGNED 0x8 //Integer is bigger than INT64_MAX
+#define JSON_FLAG_LAZY 0x10 //Container has not been built yet, see jsonParseLazy()
+#define JSON_FLAG_IN_PLACE 0x20 //String is in the buffer given to jsonParseInPlace()
+
+/*
+ * A string value that refers to the document text. The String is
+ * created on first access through jsonGetString()/jsonGetCString().
+ */
+typedef struct _JSONStringView {
+	const char *start;
+	size_t length;
+	String *string;
+	struct _Arena *arena;
+} JSONStringView;
+
+struct _JSONMember;
+struct _JSONParser;
+
 typedef struct _JSONObject {
 	JSONType type;
+	unsigned int flags;
 	union {
 		String *string;
+		JSONStringView *view;
 		double number;
-		Dictionary *object;
-		Array *array;
+		int64_t integer;
+		uint64_t unsignedInteger;
+		struct {
+			struct _JSONMember *members;
+			size_t length;
+		} object;
+		struct {
+			struct _JSONObject **items;
+			size_t length;
+		} array;
 		bool booleanValue;
 		bool isNull;
+		//Decoded and NULL terminated string of an in-place parse
+		struct {
+			const char *chars;
+			size_t length;
+		} inPlace;
+		//Where a lazy container is in the parser's span table
+		struct {
+			struct _JSONParser *parser;
+			size_t span;
+		} lazy;
 	} value;
 } JSONObject;
 
+/*
+ * A named property of a JSON object. The members of an object are
+ * stored in document order. Objects with 8 or more members are
+ * followed by a hash index for lookup, smaller ones are searched
+ * linearly.
+ */
+typedef struct _JSONMember {
+	const char *name;
+	unsigned int nameLength;
+	unsigned int hash;
+	JSONObject *value;
+} JSONMember;
+
+/*
+ * Parser scratch entry for a member or array item whose container
+ * has not been closed yet. The name lives in the scratch text, unless
+ * it is a view into the parsed data.
+ */
+typedef struct _JSONPendingMember {
+	const char *name;
+	size_t nameOffset;
+	unsigned int nameLength;
+	unsigned int hash;
+	JSONObject *value;
+} JSONPendingMember;
+
+/*
+ * A property name interned by a parser. Get one with jsonInternKey()
+ * and pass it to the jsonGet*ByKey() functions to look up a property
+ * without hashing its name again.
+ */
+typedef struct _JSONKey {
+	const char *name;
+	unsigned int length;
+	unsigned int hash;
+} JSONKey;
+
+//Segment of a compiled path
+typedef struct _JSONPathSegment {
+	const char *name;
+	unsigned int length;
+	unsigned int hash;
+	//Array index, -1 if the segment is not a number
+	int index;
+	bool wildcard;
+} JSONPathSegment;
+
+/*
+ * A path compiled by jsonCompilePath(). It can be evaluated against
+ * any number of documents without allocating memory.
+ */
+typedef struct _JSONPath {
+	JSONPathSegment *segments;
+	int length;
+} JSONPath;
+
+/*
+ * A read only document stored as one contiguous array of tagged 64 bit
+ * words. Strings are kept in a side buffer and containers store the
+ * position of their matching end so that values can be skipped over.
+ */
+typedef struct _JSONTape {
+	uint64_t *words;
+	size_t length;
+	size_t capacity;
+	char *strings;
+	size_t stringsLength;
+	size_t stringsCapacity;
+	//The file mapped by jsonLoadBinary() that holds the words and strings
+	const char *mapped;
+	size_t mappedLength;
+} JSONTape;
+
+/*
+ * Refers to a value in a JSONTape. A cursor for a value that
+ * does not exist has a NULL tape.
+ */
+typedef struct _JSONCursor {
+	const JSONTape *tape;
+	size_t index;
+} JSONCursor;
+
+typedef enum _JSONFieldType {
+	JSON_FIELD_DOUBLE,
+	JSON_FIELD_INT,
+	JSON_FIELD_INT64,
+	JSON_FIELD_UINT64,
+	JSON_FIELD_BOOL,
+	JSON_FIELD_STRING, //String *, freed by jsonFreeBinding()
+	JSON_FIELD_CHARS, //NULL terminated char array of size bytes
+	JSON_FIELD_OBJECT, //A nested struct described by schema
+	JSON_FIELD_ARRAY //Items of itemType with an int count
+} JSONFieldType;
+
+struct _JSONSchema;
+
+/*
+ * Binds a property of a JSON object to a member of a C struct at
+ * offset. An array is stored in place with room for size items or,
+ * when size is 0, as a pointer to items allocated with malloc().
+ * Items of an array may not be arrays or char arrays.
+ */
+typedef struct _JSONField {
+	const char *name;
+	JSONFieldType type;
+	size_t offset;
+	size_t size;
+	const struct _JSONSchema *schema;
+	JSONFieldType itemType;
+	size_t countOffset;
+} JSONField;
+
+//Describes a C struct of size bytes that a JSON object is bound to
+typedef struct _JSONSchema {
+	size_t size;
+	const JSONField *fields;
+	int fieldCount;
+} JSONSchema;
+
+/*
+ * Writes JSONObjects as JSON text into a growing buffer or, when
+ * created by newJSONStreamWriter(), to a file descriptor in blocks.
+ */
+typedef struct _JSONWriter {
+	char *buffer;
+	size_t length;
+	size_t capacity;
+	int fd;
+	//Set pretty to true to put every value on its own line,
+	//indented by indent spaces per level.
+	bool pretty;
+	int indent;
+	int depth;
+	ErrorCode errorCode;
+} JSONWriter;
+
+typedef enum _JSONTokenType {
+	JSON_TOKEN_ERROR,
+	JSON_TOKEN_END,
+	JSON_TOKEN_START_OBJECT,
+	JSON_TOKEN_END_OBJECT,
+	JSON_TOKEN_START_ARRAY,
+	JSON_TOKEN_END_ARRAY,
+	JSON_TOKEN_KEY,
+	JSON_TOKEN_STRING,
+	JSON_TOKEN_NUMBER,
+	JSON_TOKEN_INTEGER,
+	JSON_TOKEN_BOOLEAN,
+	JSON_TOKEN_NULL
+} JSONTokenType;
+
+/*
+ * A token returned by jsonNextToken(). The string of a key or string
+ * token is not NULL terminated. It may point into the parsed data
+ * or into the parser and is only valid until the next call.
+ */
+typedef struct _JSONToken {
+	JSONTokenType type;
+	unsigned int flags;
+	const char *string;
+	size_t length;
+	union {
+		double number;
+		int64_t integer;
+		uint64_t unsignedInteger;
+		bool booleanValue;
+	} value;
+} JSONToken;
+
+/*
+ * Statistics of the last parse. They are only collected when the library
+ * is built with JAPP_STATS defined, otherwise they stay 0. Use
+ * jsonAddStats() to add them up over many parses.
+ */
+typedef struct _JSONParserStats {
+	//Bytes of input consumed
+	size_t bytes;
+	//read() calls of a stream parse
+	size_t reads;
+	//Characters stepped back over
+	size_t putbacks;
+	//Blocks allocated for the document and their size
+	size_t allocations;
+	size_t allocatedBytes;
+	//Values created, by JSONType
+	size_t nodes[JSON_TYPE_COUNT];
+	//Deepest nesting of objects and arrays
+	size_t maxDepth;
+	//Memory of the document plus the parser's scratch space at the
+	//end of the parse. Values freed by callbacks are not subtracted.
+	size_t peakMemory;
+	//Wall time spent reading or mapping input and in the whole parse
+	double readSeconds;
+	double totalSeconds;
+} JSONParserStats;
+
+//Result of jsonParserFeed()
+typedef enum _JSONFeedStatus {
+	JSON_FEED_ERROR,
+	JSON_FEED_NEED_MORE,
+	JSON_FEED_DONE
+} JSONFeedStatus;
+
 typedef struct _JSONParser {
 	String *data;
-	int position;
-	int line;
+	size_t position;
 	const char *errorMessage;
-	int errorLine;
+	size_t errorLine;
+	//The lines of an in-memory document after lineOffset are only
+	//counted when an error is saved. errorLine holds those before it.
+	size_t lineOffset;
 	ErrorCode errorCode;
 	JSONObject *root;
 	int streamFd;
-	String *putbackBuffer;
+	//File mapped by jsonParseFile()
+	String *mappedData;
+	//Copy made by jsonParseCString() that zero copy strings point into
+	String *cStringData;
+	//Refill buffer for stream parsing. Set streamBufferSize before
+	//calling jsonParseStream to change the size of the buffer.
+	size_t streamBufferSize;
+	char *streamBuffer;
+	size_t streamBufferCapacity;
+	size_t streamBufferLength;
+	size_t streamBufferPosition;
+	//Last character read from a stream, for putback()
 	char lastReadChar;
+	//Set arenaChunkSize to a non-zero value before parsing to allocate
+	//all memory for a document from chunks of that size. Freeing the
+	//document is then a constant time operation.
+	size_t arenaChunkSize;
+	struct _Arena *arena;
+	//Set zeroCopyStrings to true to make string values and object
+	//names refer to the String passed to jsonParse() instead of
+	//copying them. The String must outlive the parsed document.
+	bool zeroCopyStrings;
+	//Set parseIntegers to true to store numbers without a fraction
+	//or exponent as JSON_INTEGER instead of JSON_NUMBER.
+	bool parseIntegers;
+	//Set validateUTF8 to true to fail with ERROR_SYNTAX on a document
+	//that is not valid UTF-8.
+	bool validateUTF8;
+	int utf8State;
+	//Set internKeys to true to store every object property name once
+	//in a table owned by the parser. The table is kept across parses.
+	bool internKeys;
+	struct _KeyTable *keys;
+	//Set projection to an array of compiled paths to build only the
+	//values on those paths. Everything else is skipped over.
+	JSONPath **projection;
+	int projectionLength;
+	//Set threads to more than 1 to split a large top level array
+	//across that many threads in jsonParse(). Callbacks and projection
+	//are not used by a parallel parse.
+	int threads;
+	struct _JSONParser **workers;
+	int workerCount;
+	//Paths that are still being followed at each level
+	int *selected;
+	int selectedLength;
+	int selectedCapacity;
+	int selectedFirst;
+	int selectedCount;
+	int selectedDepth;
+	//Nested containers are skipped and built when they are first used
+	bool lazy;
+	//Start and end of every container of a lazy parse in document
+	//order, so that building one never scans its text again
+	struct _LazySpan *spans;
+	size_t spanLength;
+	size_t spanCapacity;
+	//Span of the next container deferred while one is being built
+	size_t spanNext;
+	//Strings are decoded into the parsed data, see jsonParseInPlace()
+	bool inPlace;
+	String *inPlaceData;
+	//Filled in by every parse when built with JAPP_STATS
+	JSONParserStats stats;
+	//Set maxDepth to the deepest nesting of objects and arrays to
+	//accept. Deeper documents fail with ERROR_SYNTAX. 0 means no limit.
+	int maxDepth;
+	//Objects and arrays being parsed
+	struct _ParseFrame *frames;
+	size_t frameDepth;
+	size_t frameCapacity;
+	//Containers being freed
+	struct _ClearFrame *clearStack;
+	size_t clearStackCapacity;
+	//Scratch space for containers and strings being parsed
+	JSONPendingMember *pending;
+	size_t pendingLength;
+	size_t pendingCapacity;
+	char *text;
+	size_t textLength;
+	size_t textCapacity;
+	String *propertyName;
+	//Pull tokenizer state
+	char *tokenStack;
+	int tokenDepth;
+	int tokenStackCapacity;
+	int tokenState;
+	//Push parser state. Everything needed to resume is kept here.
+	int feedState;
+	//The string being read is a property name
+	bool feedKey;
+	//Start of the string or number being read in the scratch text
+	size_t feedOffset;
+	const char *feedLiteral;
+	int feedMatched;
+	char feedHex[5];
+	int feedHexLength;
+	int feedHigh;
+	//Bytes of the last buffer given to jsonParserFeed() that
+	//were used. Anything after them belongs to the next document.
+	size_t feedConsumed;
+	//Document built by jsonParseTape()
+	struct _JSONTape *tape;
+	//Document mapped by jsonLoadBinary()
+	struct _JSONTape *binary;
 	void (*onPropertyParsed)(struct _JSONParser* p, String *name, JSONObject *val);
 	void (*onValueParsed)(struct _JSONParser* p, JSONObject *val);
 } JSONParser;
 
+/*
+ * Parses JSON Lines, one document per line, on a pool of threads.
+ * Every worker thread has its own JSONParser.
+ */
+typedef struct _JSONLinesParser {
+	//Number of worker threads. 0 uses one per CPU.
+	int threads;
+	//Set ordered to true to get the records in input order. The
+	//callback is then never called by two threads at the same time.
+	bool ordered;
+	//Bytes read from a stream at a time
+	size_t blockSize;
+	//Called for every new worker parser. Use it to set parser options.
+	void (*onNewParser)(JSONParser *parser, void *context);
+	//Called for every record. The record is NULL if it failed to parse,
+	//the parser then has the error. line starts at 1. Unless ordered
+	//is set, this is called by many threads at once.
+	void (*onRecord)(JSONParser *parser, JSONObject *record, size_t line, void *context);
+	void *context;
+	size_t recordCount;
+	size_t errorCount;
+	ErrorCode errorCode;
+} JSONLinesParser;
+
 JSONParser *newJSONParser();
 void deleteJSONParser(JSONParser *parser);
 JSONObject *jsonParse(JSONParser *parser, String *stringToParse);
 JSONObject *jsonParseStream(JSONParser *parser, int streamFd);
 JSONObject *jsonParseCString(JSONParser *parser, const char *stringToParse);
+JSONObject *jsonParseFile(JSONParser *parser, const char *path);
+
+/*
+ * Parses an in-memory document lazily. Only the members or items of
+ * the root are built. A nested object or array is skipped over and
+ * built the first time it is read through an accessor, or by
+ * jsonExpand(). The String must not change until the parser is used
+ * again. A syntax error inside a container is found when the container
+ * is built: errorCode is then set, the container is incomplete and
+ * nothing more is built.
+ * Reading a lazy document changes it, so it may not be shared between
+ * threads. Callbacks, projection and threads are not used.
+ */
+JSONObject *jsonParseLazy(JSONParser *parser, String *stringToParse);
+void jsonExpand(JSONObject *o);
+
+/*
+ * Parses a buffer owned by the caller and changes it. Strings and
+ * property names are decoded back into the buffer and NULL terminated
+ * there, so no string is allocated or copied. jsonGetCString() and
+ * jsonGetStringView() return pointers into the buffer. jsonGetString()
+ * can not be used on the document. The buffer must be kept until the
+ * parser is used again. It is changed even if the parse fails.
+ */
+JSONObject *jsonParseInPlace(JSONParser *parser, char *buffer, size_t length);
+
+JSONLinesParser *newJSONLinesParser();
+void deleteJSONLinesParser(JSONLinesParser *lines);
+bool jsonParseLines(JSONLinesParser *lines, String *data);
+bool jsonParseLinesStream(JSONLinesParser *lines, int fd);
+
+/*
+ * Pull tokenizer. Call jsonBeginTokens() or jsonBeginTokenStream() and
+ * then jsonNextToken() until it returns JSON_TOKEN_END or
+ * JSON_TOKEN_ERROR. No JSONObject is created.
+ */
+void jsonBeginTokens(JSONParser *parser, String *stringToParse);
+void jsonBeginTokenStream(JSONParser *parser, int streamFd);
+JSONTokenType jsonNextToken(JSONParser *parser, JSONToken *token);
+//Brings errorLine up to the read position. Call it before reporting
+//an error of your own found with the tokenizer, as binding does.
+void jsonCountErrorLines(JSONParser *parser);
+
+/*
+ * Push parser. Call jsonBeginFeed() and then give the document to
+ * jsonParserFeed() in pieces of any size, as they arrive. It returns
+ * JSON_FEED_NEED_MORE until the root is complete and never blocks.
+ * The document is then in parser->root. Feed a length of 0 at the end
+ * of input to turn an unfinished document into an error.
+ */
+void jsonBeginFeed(JSONParser *parser);
+JSONFeedStatus jsonParserFeed(JSONParser *parser, const char *buffer, size_t length);
 
 //Get named properties of a JSON Object
 String *jsonGetString(JSONObject *o, const char *name);
 const char *jsonGetCString(JSONObject *o, const char *name);
 double jsonGetNumber(JSONObject *o, const char *name);
+int64_t jsonGetInteger(JSONObject *o, const char *name);
+uint64_t jsonGetUnsigned(JSONObject *o, const char *name);
 JSONObject *jsonGetObject(JSONObject *o, const char *name);
 JSONObject *jsonGetArray(JSONObject *o, const char *name);
 bool jsonGetBoolean(JSONObject *o, const char *name);
 bool jsonIsNull(JSONObject *o, const char *name);
 JSONObject *jsonGetObjectByPath(JSONObject *o, const char *path);
 JSONObject *jsonGetArrayByPath(JSONObject *o, const char *path);
+JSONPath *jsonCompilePath(const char *path);
+void deleteJSONPath(JSONPath *path);
+JSONObject *jsonPathGet(JSONPath *path, JSONObject *o);
+int jsonPathSelect(JSONPath *path, JSONObject *o, JSONObject **results, int maxResults);
+int jsonPathForEach(JSONPath *path, JSONObject *o,
+	void (*fn)(JSONObject *match, void *context), void *context);
+//Get a string property without creating a String. In zero copy mode
+//the result points into the parsed data and is not NULL terminated.
+//After jsonParseInPlace() it is NULL terminated.
+const char *jsonGetStringView(JSONObject *o, const char *name, size_t *length);
+
+//Get named properties using an interned key
+const JSONKey *jsonInternKey(JSONParser *parser, const char *name);
+String *jsonGetStringByKey(JSONObject *o, const JSONKey *key);
+const char *jsonGetCStringByKey(JSONObject *o, const JSONKey *key);
+double jsonGetNumberByKey(JSONObject *o, const JSONKey *key);
+int64_t jsonGetIntegerByKey(JSONObject *o, const JSONKey *key);
+uint64_t jsonGetUnsignedByKey(JSONObject *o, const JSONKey *key);
+JSONObject *jsonGetObjectByKey(JSONObject *o, const JSONKey *key);
+JSONObject *jsonGetArrayByKey(JSONObject *o, const JSONKey *key);
+bool jsonGetBooleanByKey(JSONObject *o, const JSONKey *key);
+bool jsonIsNullByKey(JSONObject *o, const JSONKey *key);
 
 //Get the number of items in a JSON array
-int jsonGetArrayLength(JSONObject *a);
+size_t jsonGetArrayLength(JSONObject *a);
+//Iterate the members of a JSON object in document order. In zero
+//copy mode the name is not NULL terminated.
+size_t jsonGetMemberCount(JSONObject *o);
+const char *jsonGetMemberName(JSONObject *o, size_t index, size_t *length);
+JSONObject *jsonGetMemberValue(JSONObject *o, size_t index);
 //Get indexed properties of a JSON array
-String *jsonGetStringAt(JSONObject *a, int index);
-const char *jsonGetCStringAt(JSONObject *a, int index);
-double jsonGetNumberAt(JSONObject *a, int index);
-JSONObject *jsonGetObjectAt(JSONObject *a, int index);
-JSONObject *jsonGetArrayAt(JSONObject *a, int index);
-bool jsonGetBooleanAt(JSONObject *a, int index);
-bool jsonIsNullAt(JSONObject *a, int index);
+String *jsonGetStringAt(JSONObject *a, size_t index);
+const char *jsonGetCStringAt(JSONObject *a, size_t index);
+double jsonGetNumberAt(JSONObject *a, size_t index);
+int64_t jsonGetIntegerAt(JSONObject *a, size_t index);
+uint64_t jsonGetUnsignedAt(JSONObject *a, size_t index);
+JSONObject *jsonGetObjectAt(JSONObject *a, size_t index);
+JSONObject *jsonGetArrayAt(JSONObject *a, size_t index);
+bool jsonGetBooleanAt(JSONObject *a, size_t index);
+bool jsonIsNullAt(JSONObject *a, size_t index);
+const char *jsonGetStringViewAt(JSONObject *a, size_t index, size_t *length);
+
+//Get the String of a JSON_STRING value
+String *jsonGetStringValue(JSONObject *o);
 
 void jsonPrintObject(JSONObject *o);
+void jsonAddStats(JSONParserStats *total, const JSONParserStats *stats);
+
+JSONWriter *newJSONWriter();
+JSONWriter *newJSONStreamWriter(int fd);
+void deleteJSONWriter(JSONWriter *writer);
+bool jsonWrite(JSONWriter *writer, JSONObject *o);
+bool jsonWriterFlush(JSONWriter *writer);
+void jsonWriterReset(JSONWriter *writer);
+
+/*
+ * Parses an in-memory document into a tape owned by the parser and
+ * returns a cursor to the root. The tape is reused by the next call.
+ * On error the returned cursor does not exist and errorCode is set.
+ */
+JSONCursor jsonParseTape(JSONParser *parser, String *stringToParse);
+bool jsonCursorExists(JSONCursor c);
+JSONType jsonCursorType(JSONCursor c);
+//Get the value at a cursor
+double jsonCursorNumber(JSONCursor c);
+int64_t jsonCursorInteger(JSONCursor c);
+const char *jsonCursorCString(JSONCursor c, size_t *length);
+bool jsonCursorBoolean(JSONCursor c);
+//Iterate over the items of an array
+JSONCursor jsonCursorFirst(JSONCursor a);
+JSONCursor jsonCursorNext(JSONCursor item);
+//Get named properties of an object in a tape
+JSONCursor jsonTapeGetMember(JSONCursor o, const char *name);
+double jsonTapeGetNumber(JSONCursor o, const char *name);
+int64_t jsonTapeGetInteger(JSONCursor o, const char *name);
+const char *jsonTapeGetCString(JSONCursor o, const char *name);
+bool jsonTapeGetBoolean(JSONCursor o, const char *name);
+bool jsonTapeIsNull(JSONCursor o, const char *name);
+JSONCursor jsonTapeGetObject(JSONCursor o, const char *name);
+JSONCursor jsonTapeGetArray(JSONCursor o, const char *name);
+//Get indexed properties of an array in a tape
+size_t jsonTapeGetArrayLength(JSONCursor a);
+JSONCursor jsonTapeGetAt(JSONCursor a, size_t index);
+double jsonTapeGetNumberAt(JSONCursor a, size_t index);
+int64_t jsonTapeGetIntegerAt(JSONCursor a, size_t index);
+const char *jsonTapeGetCStringAt(JSONCursor a, size_t index);
+bool jsonTapeGetBooleanAt(JSONCursor a, size_t index);
+bool jsonTapeIsNullAt(JSONCursor a, size_t index);
+JSONCursor jsonTapeGetObjectAt(JSONCursor a, size_t index);
+JSONCursor jsonTapeGetArrayAt(JSONCursor a, size_t index);
+void deleteJSONTape(JSONTape *tape);
+
+/*
+ * Saves a document in a binary file that is the tape of the document
+ * behind a header with a version and a checksum. jsonLoadBinary() maps
+ * the file and returns a cursor to the root without parsing. Use the
+ * tape accessors on it. The mapping is owned by the parser and is
+ * replaced by the next call. Files written by another version or on a
+ * machine of a different byte order, and corrupt files, fail to load.
+ */
+bool jsonSaveBinary(JSONObject *o, const char *path);
+JSONCursor jsonLoadBinary(JSONParser *parser, const char *path);
+
+/*
+ * Parses a document whose root is an object straight into a struct
+ * described by schema. No JSONObject is created. Unknown properties
+ * are skipped and null or missing ones leave the member unchanged.
+ * The struct must be zeroed or hold an earlier binding. Returns false
+ * and sets errorCode when the document is invalid or a value does not
+ * fit its field.
+ */
+bool jsonBind(JSONParser *parser, String *stringToParse,
+	const JSONSchema *schema, void *out);
+bool jsonBindCString(JSONParser *parser, const char *stringToParse,
+	const JSONSchema *schema, void *out);
+bool jsonBindStream(JSONParser *parser, int streamFd,
+	const JSONSchema *schema, void *out);
+//Free the strings and arrays allocated by binding and zero them
+void jsonFreeBinding(const JSONSchema *schema, void *out);
 
 /**
  * Deletes all children objects of a given JSONObject amd
@@ -0,0 +1,39 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+#include "Parser.h"
+#include "Stats.h"
+
+double statsClock() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Adds the statistics of a parse to a running total. Counters and
+ * times are summed, the depth and peak memory are the largest seen.
+ */
+void jsonAddStats(JSONParserStats *total, const JSONParserStats *stats) {
+	total->bytes += stats->bytes;
+	total->reads += stats->reads;
+	total->putbacks += stats->putbacks;
+	total->allocations += stats->allocations;
+	total->allocatedBytes += stats->allocatedBytes;
+
+	for (int i = 0; i < JSON_TYPE_COUNT; ++i) {
+		total->nodes[i] += stats->nodes[i];
+	}
+
+	if (stats->maxDepth > total->maxDepth) {
+		total->maxDepth = stats->maxDepth;
+	}
+	if (stats->peakMemory > total->peakMemory) {
+		total->peakMemory = stats->peakMemory;
+	}
+
+	total->readSeconds += stats->readSeconds;
+	total->totalSeconds += stats->totalSeconds;
+}
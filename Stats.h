@@ -0,0 +1,31 @@
+/*
+ * Parser statistics. They are only collected when the library is
+ * built with JAPP_STATS defined. Otherwise these macros expand to
+ * nothing and cost nothing.
+ */
+#ifdef JAPP_STATS
+
+#define STAT_ADD(p, field, n) ((p)->stats.field += (n))
+#define STAT_NODE(p, o) ((p)->stats.nodes[(o)->type] += 1)
+#define STAT_DEPTH(p, depth) do { \
+	if ((depth) > (p)->stats.maxDepth) (p)->stats.maxDepth = (depth); \
+} while (0)
+//Declares a variable holding the time a phase started
+#define STAT_START(started) double started = statsClock()
+//Adds the time since started to a phase
+#define STAT_TIME(p, field, started) ((p)->stats.field += statsClock() - (started))
+#define STAT_RESET(p) memset(&(p)->stats, 0, sizeof((p)->stats))
+
+#else
+
+#define STAT_ADD(p, field, n)
+#define STAT_NODE(p, o)
+#define STAT_DEPTH(p, depth)
+#define STAT_START(started)
+#define STAT_TIME(p, field, started)
+#define STAT_RESET(p)
+
+#endif
+
+//Seconds from a monotonic clock
+double statsClock();
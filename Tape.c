@@ -0,0 +1,1080 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include "Parser.h"
+#include "Number.h"
+#include "Escape.h"
+#include "Utf8.h"
+#include "File.h"
+
+/*
+ * Every tape word has a tag in the top 8 bits and a 56 bit payload.
+ *
+ * '{' '[' : payload has the index of the matching end word in the low
+ *           32 bits and the number of members or items above that.
+ * '}' ']' : payload is the index of the matching start word.
+ * '"'     : payload is the offset of the string in the string buffer.
+ *           A string is stored as a 32 bit length, the characters and
+ *           a NULL terminator.
+ * 'l' 'u' 'd' : int64, uint64 or double. The value is in the next word.
+ * 't' 'f' 'n' : true, false and null.
+ */
+#define TAG_SHIFT 56
+#define PAYLOAD_MASK ((1ULL << TAG_SHIFT) - 1)
+#define MAX_COUNT 0xFFFFFF
+
+#define TAG(word) ((char) ((word) >> TAG_SHIFT))
+#define PAYLOAD(word) ((word) & PAYLOAD_MASK)
+
+typedef struct _TapeBuilder {
+	JSONParser *parser;
+	JSONTape *tape;
+	const char *start;
+	const char *pos;
+	const char *end;
+	size_t *stack;
+	size_t depth;
+	size_t stackCapacity;
+} TapeBuilder;
+
+static JSONTape *newTape() {
+	JSONTape *tape = calloc(1, sizeof(JSONTape));
+
+	assert(tape != NULL);
+
+	return tape;
+}
+
+void deleteJSONTape(JSONTape *tape) {
+	if (tape->mapped != NULL) {
+		unmapFile(tape->mapped, tape->mappedLength);
+	} else {
+		free(tape->words);
+		free(tape->strings);
+	}
+	free(tape);
+}
+
+static void append(JSONTape *tape, char tag, uint64_t payload) {
+	if (tape->length == tape->capacity) {
+		tape->capacity = tape->capacity == 0 ? 1024 : tape->capacity * 2;
+		tape->words = realloc(tape->words, tape->capacity * sizeof(uint64_t));
+
+		assert(tape->words != NULL);
+	}
+
+	tape->words[tape->length++] = ((uint64_t) (unsigned char) tag << TAG_SHIFT) | payload;
+}
+
+static char *reserveStrings(JSONTape *tape, size_t length) {
+	if (tape->stringsLength + length > tape->stringsCapacity) {
+		size_t capacity = tape->stringsCapacity == 0 ? 4096 : tape->stringsCapacity;
+
+		while (capacity < tape->stringsLength + length) {
+			capacity *= 2;
+		}
+
+		tape->strings = realloc(tape->strings, capacity);
+
+		assert(tape->strings != NULL);
+
+		tape->stringsCapacity = capacity;
+	}
+
+	return tape->strings + tape->stringsLength;
+}
+
+static bool fail(TapeBuilder *b, const char *msg) {
+	JSONParser *parser = b->parser;
+
+	if (parser->errorCode == ERROR_NONE) {
+		size_t line = 0;
+
+		for (const char *c = b->start; c < b->pos && c < b->end; ++c) {
+			if (*c == '\n') {
+				++line;
+			}
+		}
+
+		parser->errorCode = ERROR_SYNTAX;
+		parser->errorMessage = msg;
+		parser->errorLine = line;
+	}
+
+	return false;
+}
+
+static void skipSpace(TapeBuilder *b) {
+	while (b->pos < b->end && (*b->pos == ' ' || *b->pos == '\n' ||
+		*b->pos == '\t' || *b->pos == '\r')) {
+		++b->pos;
+	}
+}
+
+static bool atValueEnd(TapeBuilder *b) {
+	if (b->pos >= b->end) {
+		return true;
+	}
+
+	char ch = *b->pos;
+
+	return ch == ',' || ch == '}' || ch == ']' || ch == ' ' ||
+		ch == '\n' || ch == '\t' || ch == '\r';
+}
+
+/*
+ * Adds a string to the side buffer and its word to the tape. The
+ * characters are unescaped on the way when escaped is set.
+ */
+static void appendString(JSONTape *tape, const char *s, size_t length, bool escaped) {
+	size_t offset = tape->stringsLength;
+	char *out = reserveStrings(tape, sizeof(uint32_t) + length + 1);
+	uint32_t written = escaped ?
+		unescapeString(s, length, out + sizeof(uint32_t)) : length;
+
+	if (!escaped) {
+		memcpy(out + sizeof(uint32_t), s, length);
+	}
+
+	memcpy(out, &written, sizeof(uint32_t));
+	out[sizeof(uint32_t) + written] = '\0';
+	tape->stringsLength += sizeof(uint32_t) + written + 1;
+
+	append(tape, '"', offset);
+}
+
+static bool parseString(TapeBuilder *b) {
+	bool escaped;
+	const char *error;
+	const char *start = b->pos + 1;
+	const char *quote = findStringEnd(start, b->end, &escaped, &error);
+
+	if (error != NULL) {
+		b->pos = quote;
+
+		return fail(b, error);
+	}
+
+	appendString(b->tape, start, quote - start, escaped);
+	b->pos = quote + 1;
+
+	return true;
+}
+
+static bool parseScalar(TapeBuilder *b) {
+	char ch = *b->pos;
+
+	if (ch == '"') {
+		return parseString(b);
+	}
+
+	if (ch == 't' && b->end - b->pos >= 4 && memcmp(b->pos, "true", 4) == 0) {
+		b->pos += 4;
+		append(b->tape, 't', 0);
+	} else if (ch == 'f' && b->end - b->pos >= 5 && memcmp(b->pos, "false", 5) == 0) {
+		b->pos += 5;
+		append(b->tape, 'f', 0);
+	} else if (ch == 'n' && b->end - b->pos >= 4 && memcmp(b->pos, "null", 4) == 0) {
+		b->pos += 4;
+		append(b->tape, 'n', 0);
+	} else {
+		Number n;
+		size_t length = scanNumber(b->pos, b->end, &n);
+
+		if (length == 0) {
+			return fail(b, "Invalid value.");
+		}
+
+		b->pos += length;
+
+		if (n.kind == NUMBER_DOUBLE) {
+			uint64_t bits;
+
+			memcpy(&bits, &n.value.d, sizeof(bits));
+			append(b->tape, 'd', 0);
+			append(b->tape, 0, 0);
+			b->tape->words[b->tape->length - 1] = bits;
+		} else {
+			append(b->tape, n.kind == NUMBER_INTEGER ? 'l' : 'u', 0);
+			append(b->tape, 0, 0);
+			b->tape->words[b->tape->length - 1] = n.value.u;
+		}
+	}
+
+	if (!atValueEnd(b)) {
+		return fail(b, "Invalid value.");
+	}
+
+	return true;
+}
+
+static void push(TapeBuilder *b, char tag) {
+	if (b->depth == b->stackCapacity) {
+		b->stackCapacity = b->stackCapacity == 0 ? 64 : b->stackCapacity * 2;
+		b->stack = realloc(b->stack, b->stackCapacity * sizeof(size_t));
+
+		assert(b->stack != NULL);
+	}
+
+	b->stack[b->depth++] = b->tape->length;
+	append(b->tape, tag, 0);
+}
+
+/*
+ * Closes the innermost container. The start word gets the index of
+ * the end word and the number of children.
+ */
+static void pop(TapeBuilder *b, char tag, size_t count) {
+	JSONTape *tape = b->tape;
+	size_t start = b->stack[--b->depth];
+
+	if (count > MAX_COUNT) {
+		count = MAX_COUNT;
+	}
+
+	tape->words[start] |= ((uint64_t) count << 32) | tape->length;
+	append(tape, tag, start);
+}
+
+/*
+ * Builds the tape without recursion. The stack holds the tape index
+ * of every open container, the counts of children are kept alongside.
+ */
+static bool buildTape(TapeBuilder *b) {
+	size_t *counts = NULL;
+	size_t countsCapacity = 0;
+	bool ok = false;
+
+	skipSpace(b);
+
+	if (b->pos >= b->end || (*b->pos != '{' && *b->pos != '[')) {
+		return fail(b, "Document does not start with '{' or '['.");
+	}
+
+	while (1) {
+		//At the start of a value
+		skipSpace(b);
+
+		if (b->pos >= b->end) {
+			fail(b, "Premature end of document.");
+			break;
+		}
+
+		char ch = *b->pos;
+
+		if (ch == '{' || ch == '[') {
+			if (b->parser->maxDepth > 0 && b->depth >= (size_t) b->parser->maxDepth) {
+				fail(b, "Maximum nesting depth exceeded.");
+				break;
+			}
+
+			++b->pos;
+			push(b, ch);
+
+			if (b->depth > countsCapacity) {
+				countsCapacity = countsCapacity == 0 ? 64 : countsCapacity * 2;
+				counts = realloc(counts, countsCapacity * sizeof(size_t));
+
+				assert(counts != NULL);
+			}
+			counts[b->depth - 1] = 0;
+
+			skipSpace(b);
+
+			if (b->pos < b->end && *b->pos == (ch == '{' ? '}' : ']')) {
+				++b->pos;
+				pop(b, ch == '{' ? '}' : ']', 0);
+				goto valueDone;
+			}
+			if (ch == '[') {
+				continue;
+			}
+			goto objectKey;
+		}
+
+		if (!parseScalar(b)) {
+			break;
+		}
+
+valueDone:
+		if (b->depth == 0) {
+			ok = true;
+			break;
+		}
+
+		counts[b->depth - 1] += 1;
+		skipSpace(b);
+
+		if (b->pos >= b->end) {
+			fail(b, "Premature end of document.");
+			break;
+		}
+
+		char container = TAG(b->tape->words[b->stack[b->depth - 1]]);
+
+		ch = *b->pos++;
+
+		if (ch == (container == '{' ? '}' : ']')) {
+			pop(b, ch, counts[b->depth - 1]);
+			goto valueDone;
+		}
+		if (ch != ',') {
+			--b->pos;
+			fail(b, container == '{' ?
+				"Invalid character in an object." :
+				"Invalid character in array.");
+			break;
+		}
+		if (container == '[') {
+			continue;
+		}
+
+objectKey:
+		skipSpace(b);
+
+		if (b->pos >= b->end || *b->pos != '"') {
+			fail(b, "Invalid character in an object.");
+			break;
+		}
+		if (!parseString(b)) {
+			break;
+		}
+
+		skipSpace(b);
+
+		if (b->pos >= b->end || *b->pos != ':') {
+			fail(b, "Invalid character in an object.");
+			break;
+		}
+		++b->pos;
+	}
+
+	free(counts);
+
+	return ok;
+}
+
+static bool validTapeUTF8(TapeBuilder *b) {
+	int state = UTF8_ACCEPT;
+	size_t length = b->end - b->start;
+	size_t valid = validateUTF8(b->start, length, &state);
+
+	if (valid == length && state == UTF8_ACCEPT) {
+		return true;
+	}
+
+	b->pos = b->start + valid;
+
+	return fail(b, "Invalid UTF-8 in document.");
+}
+
+JSONCursor jsonParseTape(JSONParser *parser, String *stringToParse) {
+	JSONCursor root = {NULL, 0};
+
+	parser->errorCode = ERROR_NONE;
+	parser->errorMessage = NULL;
+	parser->errorLine = 0;
+
+	if (parser->tape == NULL) {
+		parser->tape = newTape();
+	}
+
+	JSONTape *tape = parser->tape;
+
+	tape->length = 0;
+	tape->stringsLength = 0;
+
+	TapeBuilder b;
+
+	b.parser = parser;
+	b.tape = tape;
+	b.start = stringToParse->buffer;
+	b.pos = b.start;
+	b.end = b.start + stringToParse->length;
+	b.stack = NULL;
+	b.depth = 0;
+	b.stackCapacity = 0;
+
+	if (stringToParse->length >= UINT32_MAX) {
+		//End positions are stored in 32 bits
+		parser->errorCode = ERROR_SYNTAX;
+		parser->errorMessage = "Document is too large for a tape.";
+	} else if (parser->validateUTF8 && !validTapeUTF8(&b)) {
+		//The error is set
+	} else if (buildTape(&b)) {
+		root.tape = tape;
+	}
+
+	free(b.stack);
+
+	return root;
+}
+
+//Index of the word after the value at index
+static size_t nextValue(const JSONTape *tape, size_t index) {
+	uint64_t word = tape->words[index];
+
+	switch (TAG(word)) {
+		case '{':
+		case '[':
+			return (PAYLOAD(word) & 0xFFFFFFFF) + 1;
+		case 'l':
+		case 'u':
+		case 'd':
+			return index + 2;
+		default:
+			return index + 1;
+	}
+}
+
+static const char *tapeString(const JSONTape *tape, size_t index, uint32_t *length) {
+	const char *s = tape->strings + PAYLOAD(tape->words[index]);
+
+	memcpy(length, s, sizeof(uint32_t));
+
+	return s + sizeof(uint32_t);
+}
+
+static JSONCursor cursorAt(JSONCursor c, size_t index) {
+	c.index = index;
+
+	return c;
+}
+
+static JSONCursor notFound() {
+	JSONCursor c = {NULL, 0};
+
+	return c;
+}
+
+bool jsonCursorExists(JSONCursor c) {
+	return c.tape != NULL;
+}
+
+JSONType jsonCursorType(JSONCursor c) {
+	if (c.tape == NULL) {
+		return JSON_UNDEFINED;
+	}
+
+	switch (TAG(c.tape->words[c.index])) {
+		case '{': return JSON_OBJECT;
+		case '[': return JSON_ARRAY;
+		case '"': return JSON_STRING;
+		case 'd': return JSON_NUMBER;
+		case 'l':
+		case 'u': return JSON_INTEGER;
+		case 't':
+		case 'f': return JSON_BOOLEAN;
+		case 'n': return JSON_NULL;
+		default: return JSON_UNDEFINED;
+	}
+}
+
+double jsonCursorNumber(JSONCursor c) {
+	uint64_t bits = c.tape->words[c.index + 1];
+	char tag = TAG(c.tape->words[c.index]);
+
+	if (tag == 'l') {
+		return (double) (int64_t) bits;
+	} else if (tag == 'u') {
+		return (double) bits;
+	}
+
+	assert(tag == 'd');
+
+	double d;
+
+	memcpy(&d, &bits, sizeof(d));
+
+	return d;
+}
+
+int64_t jsonCursorInteger(JSONCursor c) {
+	char tag = TAG(c.tape->words[c.index]);
+
+	if (tag == 'd') {
+		return (int64_t) jsonCursorNumber(c);
+	}
+
+	assert(tag == 'l');
+
+	return (int64_t) c.tape->words[c.index + 1];
+}
+
+const char *jsonCursorCString(JSONCursor c, size_t *length) {
+	assert(TAG(c.tape->words[c.index]) == '"');
+
+	uint32_t l;
+	const char *s = tapeString(c.tape, c.index, &l);
+
+	if (length != NULL) {
+		*length = l;
+	}
+
+	return s;
+}
+
+bool jsonCursorBoolean(JSONCursor c) {
+	char tag = TAG(c.tape->words[c.index]);
+
+	assert(tag == 't' || tag == 'f');
+
+	return tag == 't';
+}
+
+/*
+ * Finds a member of an object cursor by walking its members. Values
+ * are skipped over using the offsets stored in the tape.
+ */
+JSONCursor jsonTapeGetMember(JSONCursor o, const char *name) {
+	assert(jsonCursorType(o) == JSON_OBJECT);
+
+	const JSONTape *tape = o.tape;
+	size_t length = strlen(name);
+	size_t index = o.index + 1;
+
+	while (TAG(tape->words[index]) != '}') {
+		uint32_t keyLength;
+		const char *key = tapeString(tape, index, &keyLength);
+
+		if (keyLength == length && memcmp(key, name, length) == 0) {
+			return cursorAt(o, index + 1);
+		}
+
+		index = nextValue(tape, index + 1);
+	}
+
+	return notFound();
+}
+
+size_t jsonTapeGetArrayLength(JSONCursor a) {
+	assert(jsonCursorType(a) == JSON_ARRAY);
+
+	uint64_t payload = PAYLOAD(a.tape->words[a.index]);
+	size_t count = payload >> 32;
+
+	if (count == MAX_COUNT) {
+		//Too many to store, count them
+		size_t end = payload & 0xFFFFFFFF;
+
+		count = 0;
+
+		for (size_t i = a.index + 1; i < end; i = nextValue(a.tape, i)) {
+			++count;
+		}
+	}
+
+	return count;
+}
+
+/*
+ * Finds an array item. Items are skipped one by one, so iterating
+ * with jsonCursorNext() is faster than indexing.
+ */
+JSONCursor jsonTapeGetAt(JSONCursor a, size_t index) {
+	assert(jsonCursorType(a) == JSON_ARRAY);
+
+	size_t i = a.index + 1;
+
+	while (TAG(a.tape->words[i]) != ']') {
+		if (index-- == 0) {
+			return cursorAt(a, i);
+		}
+		i = nextValue(a.tape, i);
+	}
+
+	return notFound();
+}
+
+JSONCursor jsonCursorFirst(JSONCursor a) {
+	assert(jsonCursorType(a) == JSON_ARRAY);
+
+	return TAG(a.tape->words[a.index + 1]) == ']' ?
+		notFound() : cursorAt(a, a.index + 1);
+}
+
+JSONCursor jsonCursorNext(JSONCursor item) {
+	size_t next = nextValue(item.tape, item.index);
+	char tag = TAG(item.tape->words[next]);
+
+	return tag == ']' || tag == '}' ? notFound() : cursorAt(item, next);
+}
+
+double jsonTapeGetNumber(JSONCursor o, const char *name) {
+	JSONCursor c = jsonTapeGetMember(o, name);
+
+	return c.tape == NULL ? 0.0 : jsonCursorNumber(c);
+}
+
+int64_t jsonTapeGetInteger(JSONCursor o, const char *name) {
+	JSONCursor c = jsonTapeGetMember(o, name);
+
+	return c.tape == NULL ? 0 : jsonCursorInteger(c);
+}
+
+const char *jsonTapeGetCString(JSONCursor o, const char *name) {
+	JSONCursor c = jsonTapeGetMember(o, name);
+
+	return c.tape == NULL ? NULL : jsonCursorCString(c, NULL);
+}
+
+bool jsonTapeGetBoolean(JSONCursor o, const char *name) {
+	JSONCursor c = jsonTapeGetMember(o, name);
+
+	return c.tape == NULL ? false : jsonCursorBoolean(c);
+}
+
+bool jsonTapeIsNull(JSONCursor o, const char *name) {
+	JSONCursor c = jsonTapeGetMember(o, name);
+
+	return c.tape == NULL || jsonCursorType(c) == JSON_NULL;
+}
+
+JSONCursor jsonTapeGetObject(JSONCursor o, const char *name) {
+	JSONCursor c = jsonTapeGetMember(o, name);
+
+	assert(c.tape == NULL || jsonCursorType(c) == JSON_OBJECT);
+
+	return c;
+}
+
+JSONCursor jsonTapeGetArray(JSONCursor o, const char *name) {
+	JSONCursor c = jsonTapeGetMember(o, name);
+
+	assert(c.tape == NULL || jsonCursorType(c) == JSON_ARRAY);
+
+	return c;
+}
+
+double jsonTapeGetNumberAt(JSONCursor a, size_t index) {
+	JSONCursor c = jsonTapeGetAt(a, index);
+
+	return c.tape == NULL ? 0.0 : jsonCursorNumber(c);
+}
+
+int64_t jsonTapeGetIntegerAt(JSONCursor a, size_t index) {
+	JSONCursor c = jsonTapeGetAt(a, index);
+
+	return c.tape == NULL ? 0 : jsonCursorInteger(c);
+}
+
+const char *jsonTapeGetCStringAt(JSONCursor a, size_t index) {
+	JSONCursor c = jsonTapeGetAt(a, index);
+
+	return c.tape == NULL ? NULL : jsonCursorCString(c, NULL);
+}
+
+bool jsonTapeGetBooleanAt(JSONCursor a, size_t index) {
+	JSONCursor c = jsonTapeGetAt(a, index);
+
+	return c.tape == NULL ? false : jsonCursorBoolean(c);
+}
+
+bool jsonTapeIsNullAt(JSONCursor a, size_t index) {
+	JSONCursor c = jsonTapeGetAt(a, index);
+
+	return c.tape == NULL || jsonCursorType(c) == JSON_NULL;
+}
+
+JSONCursor jsonTapeGetObjectAt(JSONCursor a, size_t index) {
+	JSONCursor c = jsonTapeGetAt(a, index);
+
+	assert(c.tape == NULL || jsonCursorType(c) == JSON_OBJECT);
+
+	return c;
+}
+
+JSONCursor jsonTapeGetArrayAt(JSONCursor a, size_t index) {
+	JSONCursor c = jsonTapeGetAt(a, index);
+
+	assert(c.tape == NULL || jsonCursorType(c) == JSON_ARRAY);
+
+	return c;
+}
+
+/*
+ * A binary file is a header followed by the words of the tape and the
+ * strings, padded with zeros to a whole number of words. The checksum
+ * covers everything after the header.
+ */
+#define BINARY_MAGIC "JTAP"
+#define BINARY_VERSION 1
+
+typedef struct _BinaryHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t wordCount;
+	uint64_t stringsLength;
+	uint64_t checksum;
+} BinaryHeader;
+
+//FNV-1a over 64 bit words
+static uint64_t checksum(uint64_t h, const uint64_t *words, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		h ^= words[i];
+		h *= 0x100000001B3ULL;
+	}
+
+	return h;
+}
+
+static void appendScalar(JSONTape *tape, JSONObject *o) {
+	switch (o->type) {
+		case JSON_STRING:
+			if (o->flags & JSON_FLAG_IN_PLACE) {
+				appendString(tape, o->value.inPlace.chars,
+					o->value.inPlace.length, false);
+			} else if (o->flags & JSON_FLAG_VIEW) {
+				appendString(tape, o->value.view->start, o->value.view->length,
+					o->flags & JSON_FLAG_ESCAPED);
+			} else {
+				appendString(tape, o->value.string->buffer,
+					o->value.string->length, false);
+			}
+			break;
+		case JSON_NUMBER:
+			append(tape, 'd', 0);
+			append(tape, 0, 0);
+			memcpy(tape->words + tape->length - 1, &o->value.number, sizeof(double));
+			break;
+		case JSON_INTEGER:
+			append(tape, o->flags & JSON_FLAG_UNSIGNED ? 'u' : 'l', 0);
+			append(tape, 0, 0);
+			tape->words[tape->length - 1] = o->value.unsignedInteger;
+			break;
+		case JSON_BOOLEAN:
+			append(tape, o->value.booleanValue ? 't' : 'f', 0);
+			break;
+		default:
+			//Null and values cleared by jsonClear()
+			append(tape, 'n', 0);
+	}
+}
+
+typedef struct _EncodeFrame {
+	JSONObject *o;
+	size_t start;
+	size_t next;
+} EncodeFrame;
+
+/*
+ * Writes a tree of JSONObject to a tape without recursion, in the
+ * same layout that jsonParseTape() builds.
+ */
+static bool encodeTape(JSONTape *tape, JSONObject *root) {
+	EncodeFrame *frames = NULL;
+	size_t depth = 0;
+	size_t capacity = 0;
+	JSONObject *o = root;
+
+	while (1) {
+		if (o != NULL) {
+			if (o->type != JSON_OBJECT && o->type != JSON_ARRAY) {
+				appendScalar(tape, o);
+			} else {
+				jsonExpand(o);
+
+				if (depth == capacity) {
+					capacity = capacity == 0 ? 64 : capacity * 2;
+					frames = realloc(frames, capacity * sizeof(EncodeFrame));
+
+					assert(frames != NULL);
+				}
+
+				frames[depth].o = o;
+				frames[depth].start = tape->length;
+				frames[depth].next = 0;
+				++depth;
+
+				append(tape, o->type == JSON_OBJECT ? '{' : '[', 0);
+			}
+		}
+
+		if (depth == 0) {
+			break;
+		}
+
+		EncodeFrame *f = frames + depth - 1;
+		bool isObject = f->o->type == JSON_OBJECT;
+		size_t length = isObject ? f->o->value.object.length : f->o->value.array.length;
+
+		if (f->next < length) {
+			if (isObject) {
+				JSONMember *m = f->o->value.object.members + f->next;
+
+				appendString(tape, m->name, m->nameLength, false);
+				o = m->value;
+			} else {
+				o = f->o->value.array.items[f->next];
+			}
+
+			++f->next;
+		} else {
+			size_t count = length > MAX_COUNT ? MAX_COUNT : length;
+
+			tape->words[f->start] |= ((uint64_t) count << 32) | tape->length;
+			append(tape, isObject ? '}' : ']', f->start);
+			o = NULL;
+			--depth;
+		}
+	}
+
+	free(frames);
+
+	//End positions are stored in 32 bits
+	return tape->length < UINT32_MAX;
+}
+
+bool jsonSaveBinary(JSONObject *o, const char *path) {
+	JSONTape *tape = newTape();
+	bool ok = encodeTape(tape, o);
+	size_t padding = (sizeof(uint64_t) - tape->stringsLength % sizeof(uint64_t)) %
+		sizeof(uint64_t);
+
+	if (padding > 0) {
+		memset(reserveStrings(tape, padding), 0, padding);
+		tape->stringsLength += padding;
+	}
+
+	BinaryHeader header;
+
+	memcpy(header.magic, BINARY_MAGIC, 4);
+	header.version = BINARY_VERSION;
+	header.wordCount = tape->length;
+	header.stringsLength = tape->stringsLength;
+	header.checksum = checksum(checksum(0xCBF29CE484222325ULL,
+		tape->words, tape->length), (uint64_t*) tape->strings,
+		tape->stringsLength / sizeof(uint64_t));
+
+	//Written under another name and renamed, so that a reader
+	//never maps a partly written file
+	size_t pathLength = strlen(path);
+	char *temp = malloc(pathLength + 5);
+
+	assert(temp != NULL);
+
+	memcpy(temp, path, pathLength);
+	memcpy(temp + pathLength, ".tmp", 5);
+
+	FILE *file = ok ? fopen(temp, "wb") : NULL;
+
+	if (file != NULL) {
+		ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+			fwrite(tape->words, sizeof(uint64_t), tape->length, file) == tape->length &&
+			(tape->stringsLength == 0 ||
+			fwrite(tape->strings, 1, tape->stringsLength, file) == tape->stringsLength);
+		ok = fclose(file) == 0 && ok;
+		ok = ok && rename(temp, path) == 0;
+
+		if (!ok) {
+			remove(temp);
+		}
+	} else {
+		ok = false;
+	}
+
+	free(temp);
+	deleteJSONTape(tape);
+
+	return ok;
+}
+
+//A container being checked by checkTape()
+typedef struct _CheckFrame {
+	size_t start;
+	//Words of names and values seen so far
+	size_t words;
+} CheckFrame;
+
+/*
+ * Checks that the accessors can not read outside a loaded tape: each
+ * container and its end word point at each other and store the right
+ * count, an object holds a string name before every value, every
+ * string lies in the string buffer with its NULL terminator and the
+ * root is one whole value. The checksum does not protect against a
+ * file made to pass it.
+ */
+static bool checkTape(const JSONTape *tape) {
+	CheckFrame *frames = NULL;
+	size_t depth = 0;
+	size_t capacity = 0;
+	size_t i = 0;
+	bool valid = true;
+
+	while (valid && i < tape->length) {
+		uint64_t word = tape->words[i];
+		char tag = TAG(word);
+		CheckFrame *parent = depth > 0 ? frames + depth - 1 : NULL;
+		bool object = parent != NULL && TAG(tape->words[parent->start]) == '{';
+
+		if (object && parent->words % 2 == 0 && tag != '"' && tag != '}') {
+			//A name must come first
+			valid = false;
+			break;
+		}
+		if (parent != NULL && tag != '}' && tag != ']') {
+			parent->words += 1;
+		}
+
+		switch (tag) {
+			case '{':
+			case '[':
+				if (depth == capacity) {
+					capacity = capacity == 0 ? 64 : capacity * 2;
+					frames = realloc(frames, capacity * sizeof(CheckFrame));
+
+					assert(frames != NULL);
+				}
+
+				frames[depth].start = i;
+				frames[depth].words = 0;
+				++depth;
+				++i;
+
+				continue;
+			case '}':
+			case ']': {
+				if (parent == NULL) {
+					valid = false;
+					break;
+				}
+
+				uint64_t start = tape->words[parent->start];
+				size_t count = object ? parent->words / 2 : parent->words;
+
+				if (count > MAX_COUNT) {
+					count = MAX_COUNT;
+				}
+
+				valid = TAG(start) == (tag == '}' ? '{' : '[') &&
+					(!object || parent->words % 2 == 0) &&
+					PAYLOAD(word) == parent->start &&
+					(PAYLOAD(start) & 0xFFFFFFFF) == i &&
+					PAYLOAD(start) >> 32 == count;
+				--depth;
+				++i;
+				break;
+			}
+			case 'l':
+			case 'u':
+			case 'd':
+				//The value is in the next word
+				valid = i + 1 < tape->length;
+				i += 2;
+				break;
+			case '"': {
+				uint64_t offset = PAYLOAD(word);
+				uint32_t length;
+
+				valid = offset <= tape->stringsLength &&
+					tape->stringsLength - offset > sizeof(uint32_t);
+
+				if (valid) {
+					memcpy(&length, tape->strings + offset, sizeof(uint32_t));
+					offset += sizeof(uint32_t);
+					valid = tape->stringsLength - offset > length &&
+						tape->strings[offset + length] == '\0';
+				}
+				++i;
+				break;
+			}
+			case 't':
+			case 'f':
+			case 'n':
+				++i;
+				break;
+			default:
+				valid = false;
+		}
+
+		if (depth == 0) {
+			//The root is done
+			break;
+		}
+	}
+
+	free(frames);
+
+	return valid && depth == 0 && i == tape->length;
+}
+
+static JSONCursor binaryError(JSONParser *parser, ErrorCode code, const char *msg) {
+	JSONCursor c = {NULL, 0};
+
+	parser->errorCode = code;
+	parser->errorMessage = msg;
+
+	return c;
+}
+
+JSONCursor jsonLoadBinary(JSONParser *parser, const char *path) {
+	parser->errorCode = ERROR_NONE;
+	parser->errorMessage = NULL;
+	parser->errorLine = 0;
+
+	if (parser->binary != NULL) {
+		deleteJSONTape(parser->binary);
+		parser->binary = NULL;
+	}
+
+	size_t length;
+	int fd;
+	const char *data = mapFile(path, &length, &fd);
+
+	if (data == NULL) {
+		if (fd >= 0) {
+			close(fd);
+		}
+
+		return binaryError(parser, ERROR_IO, "Failed to map file.");
+	}
+
+	BinaryHeader header;
+	bool valid = length >= sizeof(header);
+
+	if (valid) {
+		memcpy(&header, data, sizeof(header));
+		valid = memcmp(header.magic, BINARY_MAGIC, 4) == 0;
+	}
+	if (!valid || header.version != BINARY_VERSION) {
+		unmapFile(data, length);
+
+		return binaryError(parser, ERROR_SYNTAX, valid ?
+			"Binary file has a different version." :
+			"Not a binary JSON file.");
+	}
+
+	const uint64_t *words = (const uint64_t*) (data + sizeof(header));
+	size_t wordCount = (length - sizeof(header)) / sizeof(uint64_t);
+
+	JSONTape *tape = newTape();
+
+	tape->words = (uint64_t*) words;
+	tape->length = header.wordCount;
+	tape->strings = (char*) (words + header.wordCount);
+	tape->stringsLength = header.stringsLength;
+	tape->mapped = data;
+	tape->mappedLength = length;
+
+	//The sizes must add up and every word must be safe to read
+	valid = length % sizeof(uint64_t) == 0 &&
+		header.stringsLength % sizeof(uint64_t) == 0 &&
+		header.wordCount > 0 && header.wordCount <= wordCount &&
+		header.stringsLength / sizeof(uint64_t) == wordCount - header.wordCount &&
+		checksum(0xCBF29CE484222325ULL, words, wordCount) == header.checksum &&
+		checkTape(tape);
+
+	if (!valid) {
+		deleteJSONTape(tape);
+
+		return binaryError(parser, ERROR_SYNTAX, "Binary file is corrupt.");
+	}
+
+	parser->binary = tape;
+
+	JSONCursor root = {tape, 0};
+
+	return root;
+}
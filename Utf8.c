@@ -0,0 +1,116 @@
+#include <stdint.h>
+#include <string.h>
+#include "Utf8.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/*
+ * Byte classes: 0 ASCII, 1 80-8F, 2 90-9F, 3 A0-BF, 4 never valid,
+ * 5 start of 2 bytes, 6 E0, 7 other starts of 3 bytes, 8 ED, 9 F0,
+ * 10 F1-F3, 11 F4.
+ */
+static const unsigned char classes[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	4, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+	5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+	6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 7,
+	9, 10, 10, 10, 11, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4
+};
+
+/*
+ * States: 0 between characters, 1-3 expecting that many continuation
+ * bytes, 4 after E0 (no overlong forms), 5 after ED (no surrogates),
+ * 6 after F0 (no overlong forms), 7 after F4 (nothing above U+10FFFF).
+ */
+static const unsigned char transitions[UTF8_REJECT + 1][12] = {
+	{0, 8, 8, 8, 8, 1, 4, 2, 5, 6, 3, 7},
+	{8, 0, 0, 0, 8, 8, 8, 8, 8, 8, 8, 8},
+	{8, 1, 1, 1, 8, 8, 8, 8, 8, 8, 8, 8},
+	{8, 2, 2, 2, 8, 8, 8, 8, 8, 8, 8, 8},
+	{8, 8, 8, 1, 8, 8, 8, 8, 8, 8, 8, 8},
+	{8, 1, 1, 8, 8, 8, 8, 8, 8, 8, 8, 8},
+	{8, 8, 2, 2, 8, 8, 8, 8, 8, 8, 8, 8},
+	{8, 2, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8},
+	{8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8}
+};
+
+//Offset of the first byte at or after i that is not ASCII
+static size_t skipASCII(const char *data, size_t i, size_t length) {
+#ifdef HAVE_X86_SIMD
+	while (i + 32 <= length) {
+		__m128i a = _mm_loadu_si128((const __m128i*) (data + i));
+		__m128i b = _mm_loadu_si128((const __m128i*) (data + i + 16));
+		int mask = _mm_movemask_epi8(_mm_or_si128(a, b));
+
+		if (mask != 0) {
+			mask = _mm_movemask_epi8(a);
+
+			return mask != 0 ? i + __builtin_ctz(mask) :
+				i + 16 + __builtin_ctz(_mm_movemask_epi8(b));
+		}
+
+		i += 32;
+	}
+#endif
+	while (i + 8 <= length) {
+		uint64_t word;
+
+		memcpy(&word, data + i, sizeof(word));
+
+		if (word & 0x8080808080808080ULL) {
+			break;
+		}
+
+		i += 8;
+	}
+	while (i < length && (signed char) data[i] >= 0) {
+		++i;
+	}
+
+	return i;
+}
+
+size_t validateUTF8(const char *data, size_t length, int *state) {
+	int s = *state;
+	size_t i = 0;
+
+	if (s == UTF8_REJECT) {
+		return 0;
+	}
+
+	while (i < length) {
+		if (s == UTF8_ACCEPT) {
+			i = skipASCII(data, i, length);
+
+			if (i == length) {
+				break;
+			}
+		}
+
+		s = transitions[s][classes[(unsigned char) data[i]]];
+
+		if (s == UTF8_REJECT) {
+			break;
+		}
+
+		++i;
+	}
+
+	*state = s;
+
+	return i;
+}
@@ -0,0 +1,15 @@
+#include <stddef.h>
+
+//Validation state at the start of a document and after a whole character
+#define UTF8_ACCEPT 0
+//Validation state after an invalid byte
+#define UTF8_REJECT 8
+
+/*
+ * Validates UTF-8 text, continuing from *state so that a document can
+ * be checked in pieces. Returns length if the bytes are valid so far,
+ * otherwise the offset of the first invalid byte. At the end of the
+ * document *state must be UTF8_ACCEPT, else the last character is
+ * incomplete.
+ */
+size_t validateUTF8(const char *data, size_t length, int *state);
@@ -0,0 +1,378 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include "Parser.h"
+#include "Number.h"
+
+//Initial size of a memory writer's buffer
+#define WRITER_BUFFER_SIZE 4096
+
+/*
+ * Characters that can not be copied into a JSON string as is. The
+ * value is the character that follows the '\' or 'u' for \u00XX.
+ */
+static const char escapes[256] = {
+	[0x00] = 'u', [0x01] = 'u', [0x02] = 'u', [0x03] = 'u',
+	[0x04] = 'u', [0x05] = 'u', [0x06] = 'u', [0x07] = 'u',
+	['\b'] = 'b', ['\t'] = 't', ['\n'] = 'n', [0x0b] = 'u',
+	['\f'] = 'f', ['\r'] = 'r', [0x0e] = 'u', [0x0f] = 'u',
+	[0x10] = 'u', [0x11] = 'u', [0x12] = 'u', [0x13] = 'u',
+	[0x14] = 'u', [0x15] = 'u', [0x16] = 'u', [0x17] = 'u',
+	[0x18] = 'u', [0x19] = 'u', [0x1a] = 'u', [0x1b] = 'u',
+	[0x1c] = 'u', [0x1d] = 'u', [0x1e] = 'u', [0x1f] = 'u',
+	['"'] = '"',
+	['\\'] = '\\'
+};
+
+static JSONWriter *newWriter(int fd, size_t capacity) {
+	JSONWriter *writer = malloc(sizeof(JSONWriter));
+
+	assert(writer != NULL);
+
+	writer->capacity = capacity;
+	//One more for the NULL terminator
+	writer->buffer = malloc(capacity + 1);
+	writer->length = 0;
+	writer->fd = fd;
+	writer->pretty = false;
+	writer->indent = 2;
+	writer->depth = 0;
+	writer->errorCode = ERROR_NONE;
+
+	assert(writer->buffer != NULL);
+
+	writer->buffer[0] = '\0';
+
+	return writer;
+}
+
+JSONWriter *newJSONWriter() {
+	return newWriter(-1, WRITER_BUFFER_SIZE);
+}
+
+JSONWriter *newJSONStreamWriter(int fd) {
+	return newWriter(fd, JSON_STREAM_BUFFER_SIZE);
+}
+
+void deleteJSONWriter(JSONWriter *writer) {
+	free(writer->buffer);
+	free(writer);
+}
+
+void jsonWriterReset(JSONWriter *writer) {
+	writer->length = 0;
+	writer->buffer[0] = '\0';
+	writer->errorCode = ERROR_NONE;
+}
+
+bool jsonWriterFlush(JSONWriter *writer) {
+	if (writer->fd < 0) {
+		return writer->errorCode == ERROR_NONE;
+	}
+
+	size_t written = 0;
+
+	while (written < writer->length && writer->errorCode == ERROR_NONE) {
+		ssize_t sz = write(writer->fd, writer->buffer + written,
+			writer->length - written);
+
+		if ((sz < 0 && errno != EINTR) || sz == 0) {
+			//Nothing written would loop forever
+			writer->errorCode = ERROR_IO;
+		} else if (sz > 0) {
+			written += sz;
+		}
+	}
+
+	writer->length = 0;
+
+	return writer->errorCode == ERROR_NONE;
+}
+
+/*
+ * Makes room for length more characters. A stream writer sends out
+ * what it has first, a memory writer grows its buffer.
+ */
+static char *reserve(JSONWriter *writer, size_t length) {
+	if (writer->length + length <= writer->capacity) {
+		return writer->buffer + writer->length;
+	}
+
+	if (writer->fd >= 0) {
+		jsonWriterFlush(writer);
+
+		if (length <= writer->capacity) {
+			return writer->buffer;
+		}
+	}
+
+	size_t capacity = writer->capacity;
+
+	while (capacity < writer->length + length) {
+		capacity *= 2;
+	}
+
+	writer->buffer = realloc(writer->buffer, capacity + 1);
+
+	assert(writer->buffer != NULL);
+
+	writer->capacity = capacity;
+
+	return writer->buffer + writer->length;
+}
+
+static void append(JSONWriter *writer, const char *s, size_t length) {
+	memcpy(reserve(writer, length), s, length);
+	writer->length += length;
+}
+
+static void appendChar(JSONWriter *writer, char ch) {
+	*reserve(writer, 1) = ch;
+	writer->length += 1;
+}
+
+static void newLine(JSONWriter *writer) {
+	size_t length = 1 + (size_t) writer->depth * writer->indent;
+	char *out = reserve(writer, length);
+
+	out[0] = '\n';
+	memset(out + 1, ' ', length - 1);
+	writer->length += length;
+}
+
+/*
+ * Writes a quoted string. Runs of characters that need no escaping
+ * are copied in one go. When the text is already escaped, as in a
+ * zero copy view, only control characters are escaped.
+ */
+static void writeString(JSONWriter *writer, const char *s, size_t length, bool escaped) {
+	static const char hex[] = "0123456789abcdef";
+	size_t run = 0;
+
+	appendChar(writer, '"');
+
+	for (size_t i = 0; i < length; ++i) {
+		char escape = escapes[(unsigned char) s[i]];
+
+		if (escape == 0 || (escaped && (unsigned char) s[i] >= 0x20)) {
+			continue;
+		}
+
+		append(writer, s + run, i - run);
+		run = i + 1;
+
+		char *out = reserve(writer, 6);
+
+		out[0] = '\\';
+		out[1] = escape;
+
+		if (escape == 'u') {
+			out[2] = '0';
+			out[3] = '0';
+			out[4] = hex[(unsigned char) s[i] >> 4];
+			out[5] = hex[s[i] & 0xF];
+			writer->length += 6;
+		} else {
+			writer->length += 2;
+		}
+	}
+
+	append(writer, s + run, length - run);
+	appendChar(writer, '"');
+}
+
+static void writeStringValue(JSONWriter *writer, JSONObject *o) {
+	if (o->flags & JSON_FLAG_IN_PLACE) {
+		writeString(writer, o->value.inPlace.chars,
+			o->value.inPlace.length, false);
+	} else if (o->flags & JSON_FLAG_VIEW) {
+		JSONStringView *view = o->value.view;
+
+		//Escape sequences in the view are still valid JSON
+		writeString(writer, view->start, view->length,
+			(o->flags & JSON_FLAG_ESCAPED) != 0);
+	} else {
+		writeString(writer, o->value.string->buffer,
+			o->value.string->length, false);
+	}
+}
+
+static void writeNumber(JSONWriter *writer, JSONObject *o) {
+	char *out = reserve(writer, MAX_FORMATTED_NUMBER);
+	size_t length;
+
+	if (o->type == JSON_INTEGER) {
+		length = o->flags & JSON_FLAG_UNSIGNED ?
+			formatUnsigned(o->value.unsignedInteger, out) :
+			formatInteger(o->value.integer, out);
+	} else {
+		length = formatDouble(o->value.number, out);
+	}
+
+	if (length == 0) {
+		//NaN and infinity
+		memcpy(out, "null", 4);
+		length = 4;
+	}
+
+	writer->length += length;
+}
+
+//Writes a value that is not a container
+static void writeScalar(JSONWriter *writer, JSONObject *o) {
+	switch (o->type) {
+		case JSON_STRING:
+			writeStringValue(writer, o);
+			break;
+		case JSON_NUMBER:
+		case JSON_INTEGER:
+			writeNumber(writer, o);
+			break;
+		case JSON_BOOLEAN:
+			if (o->value.booleanValue) {
+				append(writer, "true", 4);
+			} else {
+				append(writer, "false", 5);
+			}
+			break;
+		default:
+			//Null and values cleared by jsonClear()
+			append(writer, "null", 4);
+	}
+}
+
+//A container being written by writeValue()
+typedef struct _WriteFrame {
+	JSONObject *node;
+	size_t next;
+} WriteFrame;
+
+//Frames of writeValue() kept on the C stack
+#define WRITE_STACK_SIZE 32
+
+static size_t childCount(JSONObject *o) {
+	return o->type == JSON_OBJECT ? o->value.object.length :
+		o->value.array.length;
+}
+
+/*
+ * Writes the next child of the container in f, with the separator and
+ * the name before it. Returns the child's value, or NULL after writing
+ * the end of the container.
+ */
+static JSONObject *nextChild(JSONWriter *writer, WriteFrame *f) {
+	JSONObject *o = f->node;
+	bool object = o->type == JSON_OBJECT;
+	size_t count = childCount(o);
+
+	if (f->next == count) {
+		writer->depth -= 1;
+
+		if (writer->pretty && count > 0) {
+			newLine(writer);
+		}
+
+		appendChar(writer, object ? '}' : ']');
+
+		return NULL;
+	}
+
+	size_t i = f->next++;
+
+	if (i > 0) {
+		appendChar(writer, ',');
+	}
+	if (writer->pretty) {
+		newLine(writer);
+	}
+	if (!object) {
+		return o->value.array.items[i];
+	}
+
+	JSONMember *m = o->value.object.members + i;
+
+	writeString(writer, m->name, m->nameLength, false);
+	appendChar(writer, ':');
+
+	if (writer->pretty) {
+		appendChar(writer, ' ');
+	}
+
+	return m->value;
+}
+
+/*
+ * Writes o and everything below it without recursion, so the depth
+ * of a document does not use up the C stack.
+ */
+static void writeValue(JSONWriter *writer, JSONObject *o) {
+	WriteFrame local[WRITE_STACK_SIZE];
+	WriteFrame *stack = local;
+	size_t capacity = WRITE_STACK_SIZE;
+	size_t depth = 0;
+
+	while (o != NULL) {
+		//A container of a lazy parse is built first
+		jsonExpand(o);
+
+		if (o->type == JSON_OBJECT || o->type == JSON_ARRAY) {
+			if (depth == capacity) {
+				capacity *= 2;
+
+				if (stack == local) {
+					stack = malloc(capacity * sizeof(WriteFrame));
+
+					assert(stack != NULL);
+
+					memcpy(stack, local, depth * sizeof(WriteFrame));
+				} else {
+					stack = realloc(stack, capacity * sizeof(WriteFrame));
+
+					assert(stack != NULL);
+				}
+			}
+
+			appendChar(writer, o->type == JSON_OBJECT ? '{' : '[');
+			writer->depth += 1;
+			stack[depth].node = o;
+			stack[depth++].next = 0;
+		} else {
+			writeScalar(writer, o);
+		}
+
+		//Close the containers that are done
+		o = NULL;
+
+		while (depth > 0 && (o = nextChild(writer, stack + depth - 1)) == NULL) {
+			--depth;
+		}
+	}
+
+	if (stack != local) {
+		free(stack);
+	}
+}
+
+/*
+ * Appends a value to the writer. A stream writer sends everything
+ * out before returning. Returns false on a write error.
+ */
+bool jsonWrite(JSONWriter *writer, JSONObject *o) {
+	writer->depth = 0;
+
+	writeValue(writer, o);
+
+	if (writer->pretty) {
+		appendChar(writer, '\n');
+	}
+
+	writer->buffer[writer->length] = '\0';
+
+	if (writer->fd >= 0) {
+		return jsonWriterFlush(writer);
+	}
+
+	return writer->errorCode == ERROR_NONE;
+}
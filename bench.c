@@ -0,0 +1,846 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "Parser.h"
+
+/*
+ * Benchmarks the parser on generated documents. Every corpus is built
+ * from a fixed seed, so the same document is measured on every run
+ * and every machine. Each benchmark runs in its own process so that
+ * its peak memory use can be reported on its own.
+ *
+ * Usage: bench [-json] [-time seconds] [-scale n] [-write dir] [filter]
+ *
+ * Only benchmarks whose "corpus/case" name contains filter are run.
+ * With -json every result is printed as a JSON object on its own line.
+ * -write saves the corpora in dir as files and exits.
+ */
+
+//Size of a corpus at scale 1
+#define CORPUS_SIZE (4 * 1024 * 1024)
+//Bytes given to jsonParserFeed() at a time
+#define FEED_SIZE (64 * 1024)
+
+//Allocation counters. The bench target links with --wrap for these.
+static volatile long allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+void *__wrap_malloc(size_t size) {
+	__sync_fetch_and_add(&allocations, 1);
+
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+	__sync_fetch_and_add(&allocations, 1);
+
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+	__sync_fetch_and_add(&allocations, 1);
+
+	return __real_realloc(p, size);
+}
+
+/*
+ * Corpus generation
+ */
+
+static uint64_t seed;
+
+//xorshift64*, the same sequence on every platform
+static uint64_t nextRandom() {
+	seed ^= seed >> 12;
+	seed ^= seed << 25;
+	seed ^= seed >> 27;
+
+	return seed * 2685821657736338717ULL;
+}
+
+static int randomInt(int limit) {
+	return (int) (nextRandom() % (uint64_t) limit);
+}
+
+static double randomDouble() {
+	return (double) (nextRandom() >> 11) / (double) (1ULL << 53);
+}
+
+static void append(String *s, const char *format, ...) {
+	char buffer[256];
+	va_list args;
+
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+	stringAppendCString(s, buffer);
+}
+
+static const char *words[] = {
+	"json", "parser", "fast", "stream", "value", "array", "object",
+	"Miami", "caf\\u00e9", "\\u2665", "line\\nbreak", "\\\"quoted\\\"",
+	"na\xc3\xafve", "the", "of", "and", "to", "in", "is", "http:\\/\\/x.io"
+};
+
+static void appendText(String *s, int count) {
+	stringAppendChar(s, '"');
+
+	for (int i = 0; i < count; ++i) {
+		if (i > 0) {
+			stringAppendChar(s, ' ');
+		}
+		stringAppendCString(s, words[randomInt(sizeof(words) / sizeof(words[0]))]);
+	}
+
+	stringAppendChar(s, '"');
+}
+
+//Polygons of coordinates, like canada.json
+static void numbersCorpus(String *s, size_t size) {
+	stringAppendCString(s, "{\"type\":\"FeatureCollection\",\"features\":[");
+
+	for (int f = 0; s->length < size; ++f) {
+		if (f > 0) {
+			stringAppendChar(s, ',');
+		}
+		append(s, "{\"type\":\"Feature\",\"properties\":{\"name\":\"region %d\"},"
+			"\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[[", f);
+
+		for (int i = 0; i < 1000; ++i) {
+			append(s, "%s[%.15g,%.15g]", i > 0 ? "," : "",
+				-141.0 + 90.0 * randomDouble(), 41.0 + 42.0 * randomDouble());
+		}
+
+		stringAppendCString(s, "]]}}");
+	}
+
+	stringAppendCString(s, "]}");
+}
+
+static void appendStatus(String *s, int id) {
+	append(s, "{\"id\":%d,\"created_at\":\"Sun Aug 31 00:29:%02d +0000 2014\",\"text\":",
+		id, id % 60);
+	appendText(s, 4 + randomInt(16));
+	append(s, ",\"user\":{\"id\":%d,\"name\":", randomInt(1000000000));
+	appendText(s, 2);
+	stringAppendCString(s, ",\"description\":");
+	appendText(s, randomInt(12));
+	append(s, ",\"followers_count\":%d,\"verified\":%s},",
+		randomInt(100000), randomInt(10) == 0 ? "true" : "false");
+	stringAppendCString(s, "\"entities\":{\"hashtags\":[");
+
+	for (int i = randomInt(4); i > 0; --i) {
+		appendText(s, 1);
+		if (i > 1) {
+			stringAppendChar(s, ',');
+		}
+	}
+
+	append(s, "]},\"retweet_count\":%d,\"favorited\":false,\"lang\":\"en\","
+		"\"in_reply_to\":null}", randomInt(500));
+}
+
+//Tweets, like twitter.json
+static void stringsCorpus(String *s, size_t size) {
+	stringAppendCString(s, "{\"statuses\":[");
+
+	for (int i = 0; s->length < size; ++i) {
+		if (i > 0) {
+			stringAppendChar(s, ',');
+		}
+		appendStatus(s, i);
+	}
+
+	stringAppendCString(s, "]}");
+}
+
+//Objects and arrays nested 500 levels deep
+static void nestedCorpus(String *s, size_t size) {
+	stringAppendChar(s, '[');
+
+	for (int n = 0; s->length < size; ++n) {
+		if (n > 0) {
+			stringAppendChar(s, ',');
+		}
+		for (int i = 0; i < 500; ++i) {
+			stringAppendCString(s, i % 2 ? "{\"child\":" : "[");
+		}
+		append(s, "%d", n);
+		for (int i = 499; i >= 0; --i) {
+			stringAppendCString(s, i % 2 ? "}" : ",true]");
+		}
+	}
+
+	stringAppendChar(s, ']');
+}
+
+//One flat array of mixed scalars
+static void arrayCorpus(String *s, size_t size) {
+	stringAppendChar(s, '[');
+
+	for (int n = 0; s->length < size; ++n) {
+		if (n > 0) {
+			stringAppendChar(s, ',');
+		}
+
+		switch (randomInt(5)) {
+		case 0: append(s, "%d", randomInt(2000000) - 1000000); break;
+		case 1: append(s, "%.6g", randomDouble() * 1000); break;
+		case 2: appendText(s, 1); break;
+		case 3: stringAppendCString(s, randomInt(2) ? "true" : "false"); break;
+		default: stringAppendCString(s, "null");
+		}
+	}
+
+	stringAppendChar(s, ']');
+}
+
+//One tweet per line
+static void linesCorpus(String *s, size_t size) {
+	for (int i = 0; s->length < size; ++i) {
+		appendStatus(s, i);
+		stringAppendChar(s, '\n');
+	}
+}
+
+typedef struct _Corpus {
+	const char *name;
+	void (*generate)(String *s, size_t size);
+	//Records of JSON Lines instead of one document
+	bool lines;
+} Corpus;
+
+static Corpus corpora[] = {
+	{"numbers", numbersCorpus, false},
+	{"strings", stringsCorpus, false},
+	{"nested", nestedCorpus, false},
+	{"array", arrayCorpus, false},
+	{"lines", linesCorpus, true}
+};
+
+#define CORPUS_COUNT (sizeof(corpora) / sizeof(corpora[0]))
+
+static String *generate(Corpus *c, int scale) {
+	String *s = newStringWithCapacity((size_t) CORPUS_SIZE * scale + 4096);
+
+	seed = 0x9E3779B97F4A7C15ULL;
+	c->generate(s, (size_t) CORPUS_SIZE * scale);
+
+	return s;
+}
+
+/*
+ * Benchmarks
+ */
+
+typedef struct _Run {
+	JSONParser *parser;
+	String *data;
+	const char *path;
+	int fd;
+	//Documents handled by one call of the benchmark
+	long documents;
+	//Set by a benchmark that failed
+	bool failed;
+} Run;
+
+static void check(Run *run, JSONParser *parser) {
+	if (parser->errorCode != ERROR_NONE) {
+		run->failed = true;
+	}
+}
+
+static void benchParse(Run *run) {
+	jsonParse(run->parser, run->data);
+	check(run, run->parser);
+}
+
+static void benchArena(Run *run) {
+	run->parser->arenaChunkSize = 1024 * 1024;
+	benchParse(run);
+}
+
+static void benchZeroCopy(Run *run) {
+	run->parser->arenaChunkSize = 1024 * 1024;
+	run->parser->zeroCopyStrings = true;
+	benchParse(run);
+}
+
+//The buffer is used up by a parse, so the copy is part of the time
+static void benchInPlace(Run *run) {
+	static char *buffer;
+
+	if (buffer == NULL) {
+		buffer = malloc(run->data->length);
+	}
+
+	memcpy(buffer, run->data->buffer, run->data->length);
+	run->parser->arenaChunkSize = 1024 * 1024;
+	jsonParseInPlace(run->parser, buffer, run->data->length);
+	check(run, run->parser);
+}
+
+static void benchUTF8(Run *run) {
+	run->parser->validateUTF8 = true;
+	benchParse(run);
+}
+
+static void benchCString(Run *run) {
+	jsonParseCString(run->parser, stringAsCString(run->data));
+	check(run, run->parser);
+}
+
+static void benchStream(Run *run) {
+	lseek(run->fd, 0, SEEK_SET);
+	jsonParseStream(run->parser, run->fd);
+	check(run, run->parser);
+}
+
+static void benchFile(Run *run) {
+	jsonParseFile(run->parser, run->path);
+	check(run, run->parser);
+}
+
+static void benchFeed(Run *run) {
+	const char *data = run->data->buffer;
+	size_t length = run->data->length;
+	JSONFeedStatus status = JSON_FEED_NEED_MORE;
+
+	jsonBeginFeed(run->parser);
+
+	for (size_t i = 0; i < length && status == JSON_FEED_NEED_MORE; i += FEED_SIZE) {
+		status = jsonParserFeed(run->parser, data + i,
+			length - i < FEED_SIZE ? length - i : FEED_SIZE);
+	}
+
+	if (status != JSON_FEED_DONE) {
+		run->failed = true;
+	}
+}
+
+static void benchTape(Run *run) {
+	JSONCursor c = jsonParseTape(run->parser, run->data);
+
+	if (!jsonCursorExists(c)) {
+		run->failed = true;
+	}
+}
+
+static void benchBinary(Run *run) {
+	if (run->parser->binary == NULL) {
+		//The document file is replaced by its snapshot once
+		if (jsonParse(run->parser, run->data) == NULL ||
+			!jsonSaveBinary(run->parser->root, run->path)) {
+			run->failed = true;
+			return;
+		}
+	}
+
+	if (!jsonCursorExists(jsonLoadBinary(run->parser, run->path))) {
+		run->failed = true;
+	}
+}
+
+static void benchTokens(Run *run) {
+	JSONToken token;
+
+	jsonBeginTokens(run->parser, run->data);
+
+	while (jsonNextToken(run->parser, &token) > JSON_TOKEN_END);
+
+	check(run, run->parser);
+}
+
+/*
+ * Reads every value of a document through the accessor functions.
+ * Members are looked up by name and strings are materialized.
+ */
+static double walk(JSONObject *o) {
+	double sum = 0;
+
+	//Members are read directly below
+	jsonExpand(o);
+
+	if (o->type == JSON_OBJECT) {
+		for (size_t i = 0; i < o->value.object.length; ++i) {
+			const char *name = o->value.object.members[i].name;
+			JSONObject *child = o->value.object.members[i].value;
+
+			switch (child->type) {
+			case JSON_STRING: sum += jsonGetString(o, name)->length; break;
+			case JSON_NUMBER: sum += jsonGetNumber(o, name); break;
+			case JSON_BOOLEAN: sum += jsonGetBoolean(o, name); break;
+			case JSON_NULL: sum += jsonIsNull(o, name); break;
+			case JSON_OBJECT: sum += walk(jsonGetObject(o, name)); break;
+			case JSON_ARRAY: sum += walk(jsonGetArray(o, name)); break;
+			default: break;
+			}
+		}
+	} else if (o->type == JSON_ARRAY) {
+		size_t length = jsonGetArrayLength(o);
+
+		for (size_t i = 0; i < length; ++i) {
+			switch (o->value.array.items[i]->type) {
+			case JSON_STRING: sum += jsonGetStringAt(o, i)->length; break;
+			case JSON_NUMBER: sum += jsonGetNumberAt(o, i); break;
+			case JSON_BOOLEAN: sum += jsonGetBooleanAt(o, i); break;
+			case JSON_NULL: sum += jsonIsNullAt(o, i); break;
+			case JSON_OBJECT: sum += walk(jsonGetObjectAt(o, i)); break;
+			case JSON_ARRAY: sum += walk(jsonGetArrayAt(o, i)); break;
+			default: break;
+			}
+		}
+	}
+
+	return sum;
+}
+
+static volatile double walkResult;
+
+static void benchAccess(Run *run) {
+	if (run->parser->root == NULL) {
+		//The document is parsed once, only the walk is timed
+		jsonParse(run->parser, run->data);
+		check(run, run->parser);
+	}
+
+	walkResult = walk(run->parser->root);
+}
+
+static void benchParseWalk(Run *run) {
+	benchParse(run);
+	walkResult = walk(run->parser->root);
+}
+
+//Only the root is built
+static void benchLazy(Run *run) {
+	jsonParseLazy(run->parser, run->data);
+	check(run, run->parser);
+}
+
+//Everything is built on the way
+static void benchLazyWalk(Run *run) {
+	benchLazy(run);
+	walkResult = walk(run->parser->root);
+	check(run, run->parser);
+}
+
+static void onRecord(JSONParser *parser, JSONObject *record, size_t line, void *context) {
+	if (record == NULL) {
+		*(bool*) context = true;
+	}
+}
+
+static void parseLines(Run *run, int threads) {
+	JSONLinesParser *lines = newJSONLinesParser();
+
+	lines->threads = threads;
+	lines->onRecord = onRecord;
+	lines->context = &run->failed;
+
+	jsonParseLines(lines, run->data);
+	run->documents = lines->recordCount;
+
+	deleteJSONLinesParser(lines);
+}
+
+static void benchLines(Run *run) {
+	parseLines(run, 1);
+}
+
+static void benchLinesThreads(Run *run) {
+	parseLines(run, 0);
+}
+
+static void benchLinesFeed(Run *run) {
+	const char *data = run->data->buffer;
+	size_t length = run->data->length;
+	size_t position = 0;
+	long count = 0;
+
+	//Every record is fed as it arrives on a connection
+	while (position < length) {
+		jsonBeginFeed(run->parser);
+
+		if (jsonParserFeed(run->parser, data + position,
+			length - position) != JSON_FEED_DONE) {
+			run->failed = true;
+			break;
+		}
+
+		position += run->parser->feedConsumed;
+		++count;
+
+		while (position < length && data[position] == '\n') {
+			++position;
+		}
+	}
+
+	run->documents = count;
+}
+
+/*
+ * A tweet bound into structs, straight from the text or by copying
+ * from a parsed document.
+ */
+typedef struct _User {
+	int64_t id;
+	String *name;
+	String *description;
+	int followersCount;
+	bool verified;
+} User;
+
+typedef struct _Status {
+	int64_t id;
+	char createdAt[32];
+	String *text;
+	User user;
+	String **hashtags;
+	int hashtagCount;
+	int retweetCount;
+	bool favorited;
+	char lang[8];
+} Status;
+
+static const JSONField userFields[] = {
+	{"id", JSON_FIELD_INT64, offsetof(User, id)},
+	{"name", JSON_FIELD_STRING, offsetof(User, name)},
+	{"description", JSON_FIELD_STRING, offsetof(User, description)},
+	{"followers_count", JSON_FIELD_INT, offsetof(User, followersCount)},
+	{"verified", JSON_FIELD_BOOL, offsetof(User, verified)}
+};
+
+static const JSONSchema userSchema = {sizeof(User), userFields, 5};
+
+static const JSONField entitiesFields[] = {
+	{"hashtags", JSON_FIELD_ARRAY, offsetof(Status, hashtags), 0, NULL,
+		JSON_FIELD_STRING, offsetof(Status, hashtagCount)}
+};
+
+//The entities object is bound into the Status itself
+static const JSONSchema entitiesSchema = {sizeof(Status), entitiesFields, 1};
+
+static const JSONField statusFields[] = {
+	{"id", JSON_FIELD_INT64, offsetof(Status, id)},
+	{"created_at", JSON_FIELD_CHARS, offsetof(Status, createdAt), 32},
+	{"text", JSON_FIELD_STRING, offsetof(Status, text)},
+	{"user", JSON_FIELD_OBJECT, offsetof(Status, user), 0, &userSchema},
+	{"entities", JSON_FIELD_OBJECT, 0, 0, &entitiesSchema},
+	{"retweet_count", JSON_FIELD_INT, offsetof(Status, retweetCount)},
+	{"favorited", JSON_FIELD_BOOL, offsetof(Status, favorited)},
+	{"lang", JSON_FIELD_CHARS, offsetof(Status, lang), 8}
+};
+
+static const JSONSchema statusSchema = {sizeof(Status), statusFields, 8};
+
+static void copyString(String **to, String *from) {
+	if (*to == NULL) {
+		*to = newStringWithCapacity(from->length);
+	}
+
+	(*to)->length = 0;
+	stringAppendBuffer(*to, from->buffer, from->length);
+}
+
+static void copyStatus(Status *status, JSONObject *o) {
+	status->id = jsonGetInteger(o, "id");
+	snprintf(status->createdAt, sizeof(status->createdAt), "%s",
+		jsonGetCString(o, "created_at"));
+	copyString(&status->text, jsonGetString(o, "text"));
+
+	JSONObject *user = jsonGetObject(o, "user");
+
+	status->user.id = jsonGetInteger(user, "id");
+	copyString(&status->user.name, jsonGetString(user, "name"));
+	copyString(&status->user.description, jsonGetString(user, "description"));
+	status->user.followersCount = (int) jsonGetInteger(user, "followers_count");
+	status->user.verified = jsonGetBoolean(user, "verified");
+
+	JSONObject *hashtags = jsonGetArray(jsonGetObject(o, "entities"), "hashtags");
+	size_t count = jsonGetArrayLength(hashtags);
+
+	for (int i = 0; i < status->hashtagCount; ++i) {
+		deleteString(status->hashtags[i]);
+	}
+
+	status->hashtags = realloc(status->hashtags, (count + 1) * sizeof(String*));
+	status->hashtagCount = (int) count;
+
+	for (size_t i = 0; i < count; ++i) {
+		status->hashtags[i] = NULL;
+		copyString(&status->hashtags[i], jsonGetStringAt(hashtags, i));
+	}
+
+	status->retweetCount = (int) jsonGetInteger(o, "retweet_count");
+	status->favorited = jsonGetBoolean(o, "favorited");
+	snprintf(status->lang, sizeof(status->lang), "%s", jsonGetCString(o, "lang"));
+}
+
+static void bindLines(Run *run, bool bind) {
+	const char *data = run->data->buffer;
+	const char *end = data + run->data->length;
+	Status status;
+	String line;
+	long count = 0;
+
+	memset(&status, 0, sizeof(status));
+
+	for (const char *c = data; c < end; c = (char*) line.buffer + line.length + 1) {
+		const char *newline = memchr(c, '\n', end - c);
+
+		line.buffer = (char*) c;
+		line.length = (newline != NULL ? newline : end) - c;
+		line.capacity = line.length;
+
+		if (bind) {
+			jsonBind(run->parser, &line, &statusSchema, &status);
+		} else if (jsonParse(run->parser, &line) != NULL) {
+			copyStatus(&status, run->parser->root);
+		}
+
+		check(run, run->parser);
+		++count;
+	}
+
+	jsonFreeBinding(&statusSchema, &status);
+	run->documents = count;
+}
+
+static void benchLinesBind(Run *run) {
+	bindLines(run, true);
+}
+
+static void benchLinesCopy(Run *run) {
+	bindLines(run, false);
+}
+
+typedef struct _Case {
+	const char *name;
+	void (*run)(Run *run);
+	//Works on a JSON Lines corpus instead of a document
+	bool lines;
+} Case;
+
+static Case cases[] = {
+	{"parse", benchParse, false},
+	{"parse-arena", benchArena, false},
+	{"parse-zerocopy", benchZeroCopy, false},
+	{"parse-inplace", benchInPlace, false},
+	{"parse-utf8", benchUTF8, false},
+	{"parse-cstring", benchCString, false},
+	{"parse-stream", benchStream, false},
+	{"parse-file", benchFile, false},
+	{"feed", benchFeed, false},
+	{"tape", benchTape, false},
+	{"binary-load", benchBinary, false},
+	{"tokens", benchTokens, false},
+	{"access", benchAccess, false},
+	{"parse-access", benchParseWalk, false},
+	{"lazy", benchLazy, false},
+	{"lazy-access", benchLazyWalk, false},
+	{"lines", benchLines, true},
+	{"lines-threads", benchLinesThreads, true},
+	{"lines-feed", benchLinesFeed, true},
+	{"lines-bind", benchLinesBind, true},
+	{"lines-copy", benchLinesCopy, true}
+};
+
+#define CASE_COUNT (sizeof(cases) / sizeof(cases[0]))
+
+typedef struct _Options {
+	bool json;
+	double time;
+	int scale;
+	const char *filter;
+	const char *writeDir;
+} Options;
+
+static double now() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(Options *options, Corpus *corpus, Case *c, size_t bytes,
+	double seconds, long iterations, long documents, long allocs, long peakKB) {
+	double mbps = bytes * (double) iterations / seconds / 1e6;
+	double docsps = documents / seconds;
+	double allocsPerDoc = documents > 0 ? (double) allocs / documents : 0;
+
+	if (options->json) {
+		printf("{\"corpus\":\"%s\",\"case\":\"%s\",\"bytes\":%zu,"
+			"\"iterations\":%ld,\"seconds\":%.6f,\"mbPerSecond\":%.2f,"
+			"\"documentsPerSecond\":%.1f,\"allocationsPerDocument\":%.2f,"
+			"\"peakRssKB\":%ld}\n", corpus->name, c->name, bytes,
+			iterations, seconds, mbps, docsps, allocsPerDoc, peakKB);
+	} else {
+		printf("%-8s %-15s %10.1f %14.1f %14.1f %12ld\n", corpus->name, c->name,
+			mbps, docsps, allocsPerDoc, peakKB);
+	}
+	fflush(stdout);
+}
+
+//Runs one benchmark. Called in a child process.
+static int runCase(Options *options, Corpus *corpus, Case *c) {
+	String *data = generate(corpus, options->scale);
+	char path[] = "/tmp/japp-bench-XXXXXX";
+	Run run;
+
+	run.parser = newJSONParser();
+	run.data = data;
+	run.path = path;
+	run.documents = 1;
+	run.failed = false;
+	run.fd = mkstemp(path);
+
+	if (run.fd < 0 || write(run.fd, data->buffer, data->length) != (ssize_t) data->length) {
+		fprintf(stderr, "Failed to write %s\n", path);
+		return 1;
+	}
+
+	//Warm up, and set up the access benchmark
+	c->run(&run);
+
+	long iterations = 0;
+	long documents = 0;
+	long allocs = allocations;
+	double start = now();
+	double seconds;
+
+	do {
+		c->run(&run);
+		++iterations;
+		documents += run.documents;
+		seconds = now() - start;
+	} while (seconds < options->time && !run.failed);
+
+	allocs = allocations - allocs;
+
+	close(run.fd);
+	unlink(path);
+
+	if (run.failed) {
+		fprintf(stderr, "%s/%s failed: %s\n", corpus->name, c->name,
+			run.parser->errorMessage != NULL ? run.parser->errorMessage : "");
+		return 1;
+	}
+
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+
+	report(options, corpus, c, data->length, seconds, iterations,
+		documents, allocs, usage.ru_maxrss);
+
+	deleteJSONParser(run.parser);
+	deleteString(data);
+
+	return 0;
+}
+
+static int writeCorpora(Options *options) {
+	for (size_t i = 0; i < CORPUS_COUNT; ++i) {
+		char path[1024];
+		String *data = generate(corpora + i, options->scale);
+
+		snprintf(path, sizeof(path), "%s/%s.%s", options->writeDir,
+			corpora[i].name, corpora[i].lines ? "jsonl" : "json");
+
+		FILE *file = fopen(path, "w");
+
+		if (file == NULL || fwrite(data->buffer, 1, data->length, file) != data->length) {
+			fprintf(stderr, "Failed to write %s\n", path);
+			return 1;
+		}
+
+		fclose(file);
+		deleteString(data);
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	Options options = {false, 1.0, 1, NULL, NULL};
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-json") == 0) {
+			options.json = true;
+		} else if (strcmp(argv[i], "-time") == 0 && i + 1 < argc) {
+			options.time = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-scale") == 0 && i + 1 < argc) {
+			options.scale = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-write") == 0 && i + 1 < argc) {
+			options.writeDir = argv[++i];
+		} else if (argv[i][0] != '-') {
+			options.filter = argv[i];
+		} else {
+			puts("Usage: bench [-json] [-time seconds] [-scale n] [-write dir] [filter]");
+			return 1;
+		}
+	}
+
+	if (options.scale < 1) {
+		options.scale = 1;
+	}
+	if (options.writeDir != NULL) {
+		return writeCorpora(&options);
+	}
+	if (!options.json) {
+		printf("%-8s %-15s %10s %14s %14s %12s\n", "corpus", "case",
+			"MB/s", "documents/s", "allocs/doc", "peak RSS KB");
+	}
+	fflush(stdout);
+
+	int failures = 0;
+
+	for (size_t i = 0; i < CORPUS_COUNT; ++i) {
+		for (size_t j = 0; j < CASE_COUNT; ++j) {
+			char name[64];
+
+			if (corpora[i].lines != cases[j].lines) {
+				continue;
+			}
+
+			snprintf(name, sizeof(name), "%s/%s", corpora[i].name, cases[j].name);
+
+			if (options.filter != NULL && strstr(name, options.filter) == NULL) {
+				continue;
+			}
+
+			//A process of its own for the peak memory use of the case
+			pid_t pid = fork();
+
+			if (pid == 0) {
+				exit(runCase(&options, corpora + i, cases + j));
+			}
+
+			int status = 1;
+
+			if (pid < 0 || waitpid(pid, &status, 0) < 0 ||
+				!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+				++failures;
+			}
+		}
+	}
+
+	return failures == 0 ? 0 : 1;
+}
@@ -1,46 +1,765 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
 
 #include "Parser.h"
 
-String *loadFile(const char *file) {
-	FILE *f = fopen(file, "r");
+static int failures = 0;
 
-	if (f == NULL) {
-		return NULL;
-	}
+//Prints a check that does not hold and fails the test at the end
+#define CHECK(condition) do { \
+	if (!(condition)) { \
+		printf("%s:%d: Check failed: %s\n", __FILE__, __LINE__, #condition); \
+		failures += 1; \
+	} \
+} while (0)
 
-	String *s = newStringWithCapacity(1024);
+//Parses text in place from a copy. Returns the error code.
+static ErrorCode parseInPlace(const char *text, size_t length) {
 	char buffer[256];
-	size_t sz;
 
-	while ((sz = fread(buffer, 1, sizeof(buffer), f)) > 0) {
-		stringAppendBuffer(s, buffer, sz);
-		if (sz < sizeof(buffer)) {
-			break;
+	assert(length <= sizeof(buffer));
+	memcpy(buffer, text, length);
+
+	JSONParser *p = newJSONParser();
+
+	jsonParseInPlace(p, buffer, length);
+
+	ErrorCode code = p->errorCode;
+
+	deleteJSONParser(p);
+
+	return code;
+}
+
+//True if o is written as the expected compact JSON
+static bool writesAs(JSONObject *o, const char *expected) {
+	JSONWriter *w = newJSONWriter();
+
+	jsonWrite(w, o);
+
+	bool same = w->length == strlen(expected) &&
+		memcmp(w->buffer, expected, w->length) == 0;
+
+	if (!same) {
+		printf("Wrote %.*s instead of %s\n", (int) w->length, w->buffer, expected);
+	}
+
+	deleteJSONWriter(w);
+
+	return same;
+}
+
+static void testNumbers() {
+	JSONParser *p = newJSONParser();
+	JSONObject *o = jsonParseCString(p, "[5e-324, 1e-310, 0.1, 1e23, -2.5, 1234.56]");
+
+	//Doubles are written with the fewest digits that read back
+	CHECK(writesAs(o, "[5e-324,1e-310,0.1,1e+23,-2.5,1234.56]"));
+
+	deleteJSONParser(p);
+}
+
+//Reads a whole file into a new String
+static String *readFile(const char *path) {
+	FILE *file = fopen(path, "rb");
+	String *s = newString();
+	char block[4096];
+	size_t length;
+
+	assert(file != NULL);
+
+	while ((length = fread(block, 1, sizeof(block), file)) > 0) {
+		stringAppendBuffer(s, block, length);
+	}
+
+	fclose(file);
+
+	return s;
+}
+
+static void writeFile(const char *path, const String *s) {
+	FILE *file = fopen(path, "wb");
+
+	assert(file != NULL);
+
+	fwrite(s->buffer, 1, s->length, file);
+	fclose(file);
+}
+
+//Layout of a binary file, see Tape.c
+#define BINARY_HEADER_SIZE 32
+#define BINARY_CHECKSUM_OFFSET 24
+
+//Stores the checksum of a binary file changed by a test
+static void signBinary(String *s) {
+	uint64_t h = 0xCBF29CE484222325ULL;
+
+	for (size_t i = BINARY_HEADER_SIZE; i < s->length; i += 8) {
+		uint64_t word;
+
+		memcpy(&word, s->buffer + i, 8);
+		h ^= word;
+		h *= 0x100000001B3ULL;
+	}
+
+	memcpy(s->buffer + BINARY_CHECKSUM_OFFSET, &h, 8);
+}
+
+//Loads a binary file and returns the error code
+static ErrorCode loadBinary(const char *path) {
+	JSONParser *p = newJSONParser();
+
+	jsonLoadBinary(p, path);
+
+	ErrorCode code = p->errorCode;
+
+	deleteJSONParser(p);
+
+	return code;
+}
+
+static void testBinary() {
+	const char *path = "test-binary.tmp";
+	JSONParser *p = newJSONParser();
+	JSONObject *o = jsonParseCString(p,
+		"{\"name\": \"Barry\", \"list\": [1, 2.5, true, null, {\"a\": \"b\"}]}");
+
+	CHECK(jsonSaveBinary(o, path));
+	deleteJSONParser(p);
+
+	p = newJSONParser();
+
+	JSONCursor root = jsonLoadBinary(p, path);
+	JSONCursor list = jsonTapeGetArray(root, "list");
+
+	CHECK(p->errorCode == ERROR_NONE);
+	CHECK(strcmp(jsonTapeGetCString(root, "name"), "Barry") == 0);
+	CHECK(jsonTapeGetArrayLength(list) == 5);
+	CHECK(jsonTapeGetNumberAt(list, 1) == 2.5);
+	CHECK(jsonTapeGetBooleanAt(list, 2));
+	CHECK(jsonTapeIsNullAt(list, 3));
+	CHECK(strcmp(jsonTapeGetCString(jsonTapeGetObjectAt(list, 4), "a"), "b") == 0);
+	deleteJSONParser(p);
+
+	String *good = readFile(path);
+	String *bad = newStringWithCapacity(good->length);
+
+	stringAppendBuffer(bad, good->buffer, good->length);
+
+	//A changed byte fails the checksum
+	bad->buffer[BINARY_HEADER_SIZE + 9] ^= 1;
+	writeFile(path, bad);
+	CHECK(loadBinary(path) == ERROR_SYNTAX);
+
+	//So do words that point outside the tape with a matching checksum
+	for (size_t i = BINARY_HEADER_SIZE; i + 8 <= good->length; i += 8) {
+		uint64_t word;
+
+		memcpy(&word, good->buffer + i, 8);
+
+		char tag = (char) (word >> 56);
+
+		if ((tag == '{' && i > BINARY_HEADER_SIZE) || tag == '"') {
+			memcpy(bad->buffer, good->buffer, good->length);
+			word |= 0xFFFFF;
+			memcpy(bad->buffer + i, &word, 8);
+			signBinary(bad);
+			writeFile(path, bad);
+			CHECK(loadBinary(path) == ERROR_SYNTAX);
+		}
+	}
+
+	deleteString(good);
+	deleteString(bad);
+	remove(path);
+}
+
+static void testEscapes() {
+	//A NUL byte is not an escape, even in a buffer that may hold one
+	CHECK(parseInPlace("[\"a\\\0\"]", 7) == ERROR_SYNTAX);
+	CHECK(parseInPlace("[\"a\\/\"]", 7) == ERROR_NONE);
+	CHECK(parseInPlace("[\"a\\x\"]", 7) == ERROR_SYNTAX);
+}
+
+//True if the token is a key or string with the given text
+static bool tokenIs(const JSONToken *t, JSONTokenType type, const char *text) {
+	return t->type == type && t->length == strlen(text) &&
+		memcmp(t->string, text, t->length) == 0;
+}
+
+static void testTokens() {
+	JSONParser *p = newJSONParser();
+	String *s = newStringWithCString(
+		"{\"a\": [1, -2.5, \"x\\ny\", true, null], \"b\": {}}");
+	JSONToken t;
+
+	p->parseIntegers = true;
+	jsonBeginTokens(p, s);
+
+	CHECK(jsonNextToken(p, &t) == JSON_TOKEN_START_OBJECT);
+	jsonNextToken(p, &t);
+	CHECK(tokenIs(&t, JSON_TOKEN_KEY, "a"));
+	CHECK(jsonNextToken(p, &t) == JSON_TOKEN_START_ARRAY);
+	CHECK(jsonNextToken(p, &t) == JSON_TOKEN_INTEGER && t.value.integer == 1);
+	CHECK(jsonNextToken(p, &t) == JSON_TOKEN_NUMBER && t.value.number == -2.5);
+	//Escapes are decoded
+	jsonNextToken(p, &t);
+	CHECK(tokenIs(&t, JSON_TOKEN_STRING, "x\ny"));
+	CHECK(jsonNextToken(p, &t) == JSON_TOKEN_BOOLEAN && t.value.booleanValue);
+	CHECK(jsonNextToken(p, &t) == JSON_TOKEN_NULL);
+	CHECK(jsonNextToken(p, &t) == JSON_TOKEN_END_ARRAY);
+	jsonNextToken(p, &t);
+	CHECK(tokenIs(&t, JSON_TOKEN_KEY, "b"));
+	CHECK(jsonNextToken(p, &t) == JSON_TOKEN_START_OBJECT);
+	CHECK(jsonNextToken(p, &t) == JSON_TOKEN_END_OBJECT);
+	CHECK(jsonNextToken(p, &t) == JSON_TOKEN_END_OBJECT);
+	CHECK(jsonNextToken(p, &t) == JSON_TOKEN_END);
+	CHECK(p->errorCode == ERROR_NONE);
+
+	deleteString(s);
+	deleteJSONParser(p);
+
+	//A trailing comma stops the tokens with an error
+	p = newJSONParser();
+	s = newStringWithCString("[1,]");
+	jsonBeginTokens(p, s);
+
+	CHECK(jsonNextToken(p, &t) == JSON_TOKEN_START_ARRAY);
+	CHECK(jsonNextToken(p, &t) == JSON_TOKEN_NUMBER);
+	CHECK(jsonNextToken(p, &t) == JSON_TOKEN_ERROR);
+	CHECK(p->errorCode == ERROR_SYNTAX);
+
+	deleteString(s);
+	deleteJSONParser(p);
+}
+
+static void countMatch(JSONObject *match, void *context) {
+	(void) match;
+	*(int *) context += 1;
+}
+
+static void testPaths() {
+	JSONParser *p = newJSONParser();
+	JSONObject *o = jsonParseCString(p,
+		"{\"orders\": [{\"id\": 1, \"items\": [{\"sku\": \"a\"}, {\"sku\": \"b\"}]}, "
+		"{\"id\": 2, \"items\": [{\"sku\": \"c\"}]}]}");
+	JSONObject *results[2];
+	int count = 0;
+
+	JSONPath *id = jsonCompilePath("/orders/1/id");
+
+	CHECK(writesAs(jsonPathGet(id, o), "2"));
+	deleteJSONPath(id);
+
+	//The total is returned even when only some matches fit
+	JSONPath *skus = jsonCompilePath("/orders/*/items/*/sku");
+
+	CHECK(jsonPathSelect(skus, o, results, 2) == 3);
+	CHECK(writesAs(results[0], "\"a\""));
+	CHECK(writesAs(results[1], "\"b\""));
+	CHECK(writesAs(jsonPathGet(skus, o), "\"a\""));
+	CHECK(jsonPathForEach(skus, o, countMatch, &count) == 3);
+	CHECK(count == 3);
+	deleteJSONPath(skus);
+
+	//A missing member or index does not match
+	JSONPath *price = jsonCompilePath("/orders/*/price");
+	JSONPath *beyond = jsonCompilePath("/orders/2/id");
+	JSONPath *intoNumber = jsonCompilePath("/orders/0/id/x");
+
+	CHECK(jsonPathGet(price, o) == NULL);
+	CHECK(jsonPathSelect(price, o, results, 2) == 0);
+	CHECK(jsonPathGet(beyond, o) == NULL);
+	CHECK(jsonPathGet(intoNumber, o) == NULL);
+	deleteJSONPath(price);
+	deleteJSONPath(beyond);
+	deleteJSONPath(intoNumber);
+
+	deleteJSONParser(p);
+}
+
+static void testProjection() {
+	JSONParser *p = newJSONParser();
+	JSONPath *paths[] = {
+		jsonCompilePath("/id"),
+		jsonCompilePath("/orders/*/total")
+	};
+
+	p->projection = paths;
+	p->projectionLength = 2;
+
+	//Skipped values hold brackets and quotes inside strings
+	JSONObject *o = jsonParseCString(p,
+		"{\"note\": \"a ] } \\\" [\", "
+		"\"orders\": [{\"total\": 5, \"lines\": [[1, {\"x\": \"}\"}]], \"tag\": \"\\\\\"}, "
+		"{\"skip\": {\"a\": [1, 2]}, \"total\": 7}], "
+		"\"id\": 3, \"tail\": [{\"]\": \"[\"}]}");
+
+	CHECK(p->errorCode == ERROR_NONE);
+	CHECK(writesAs(o, "{\"orders\":[{\"total\":5},{\"total\":7}],\"id\":3}"));
+
+	deleteJSONParser(p);
+	deleteJSONPath(paths[0]);
+	deleteJSONPath(paths[1]);
+}
+
+#define LINES_COUNT 20000
+
+typedef struct _LinesCheck {
+	//Per line: 1 for a record with the right value, 2 for an error
+	char seen[LINES_COUNT + 1];
+	size_t lastLine;
+	bool outOfOrder;
+	bool ordered;
+} LinesCheck;
+
+static void checkRecord(JSONParser *parser, JSONObject *record, size_t line, void *context) {
+	LinesCheck *check = context;
+
+	(void) parser;
+	assert(line >= 1 && line <= LINES_COUNT);
+
+	if (record == NULL) {
+		check->seen[line] = 2;
+	} else if (jsonGetNumber(record, "n") == (double) line) {
+		check->seen[line] = 1;
+	}
+	//Only one thread delivers at a time when ordered
+	if (check->ordered) {
+		check->outOfOrder |= line <= check->lastLine;
+		check->lastLine = line;
+	}
+}
+
+static void testLines(bool ordered) {
+	String *data = newString();
+	LinesCheck *check = calloc(1, sizeof(LinesCheck));
+	char line[64];
+
+	//Every 100th line is broken and blank lines are skipped
+	for (int i = 1; i <= LINES_COUNT; ++i) {
+		if (i % 100 == 0) {
+			stringAppendCString(data, "{\"n\": \n");
+		} else if (i % 100 == 50) {
+			stringAppendCString(data, " \n");
+		} else {
+			snprintf(line, sizeof(line), "{\"n\": %d}\n", i);
+			stringAppendCString(data, line);
 		}
 	}
 
-	fclose(f);
+	JSONLinesParser *lines = newJSONLinesParser();
+
+	check->ordered = ordered;
+	lines->threads = 4;
+	lines->ordered = ordered;
+	lines->onRecord = checkRecord;
+	lines->context = check;
+
+	CHECK(jsonParseLines(lines, data));
+	CHECK(lines->recordCount == LINES_COUNT - LINES_COUNT / 100);
+	CHECK(lines->errorCount == LINES_COUNT / 100);
+	CHECK(!check->outOfOrder);
+
+	int wrong = 0;
+
+	for (int i = 1; i <= LINES_COUNT; ++i) {
+		char expected = i % 100 == 0 ? 2 : i % 100 == 50 ? 0 : 1;
+
+		wrong += check->seen[i] != expected;
+	}
+	CHECK(wrong == 0);
+
+	deleteJSONLinesParser(lines);
+	deleteString(data);
+	free(check);
+}
+
+//Writes o and returns the text as a new String
+static String *writeText(JSONObject *o) {
+	JSONWriter *w = newJSONWriter();
+
+	jsonWrite(w, o);
+
+	String *text = newStringWithCapacity(w->length);
+
+	stringAppendBuffer(text, w->buffer, w->length);
+	deleteJSONWriter(w);
+
+	return text;
+}
+
+#define PARALLEL_ITEMS 20000
+
+/*
+ * Makes a root array of objects with one item per line, large enough to
+ * be split across 4 threads. The strings hold commas, brackets and
+ * escaped quotes. If brokenItem is not negative that item is invalid.
+ */
+static String *parallelDocument(int brokenItem) {
+	String *s = newStringWithCString("[\n");
+	char item[160];
+
+	for (int i = 0; i < PARALLEL_ITEMS; ++i) {
+		if (i == brokenItem) {
+			snprintf(item, sizeof(item), "{\"id\": %d, \"name\": },\n", i);
+		} else {
+			snprintf(item, sizeof(item),
+				"{\"id\": %d, \"name\": \"a,b] \\\"c,]\\\" [%d\", "
+				"\"tags\": [\"]\", \",\", \"\\\\\"], \"v\": %d.5}%s\n",
+				i, i, i, i + 1 < PARALLEL_ITEMS ? "," : "");
+		}
+		stringAppendCString(s, item);
+	}
+	stringAppendCString(s, "]");
 
 	return s;
 }
 
+static void testParallel() {
+	String *data = parallelDocument(-1);
+	JSONParser *serial = newJSONParser();
+	JSONParser *parallel = newJSONParser();
+
+	parallel->threads = 4;
+	parallel->internKeys = true;
+
+	assert(data->length > 4 * 256 * 1024);
+
+	JSONObject *expected = jsonParse(serial, data);
+	JSONObject *o = jsonParse(parallel, data);
+
+	CHECK(serial->errorCode == ERROR_NONE);
+	CHECK(parallel->errorCode == ERROR_NONE);
+
+	String *expectedText = writeText(expected);
+	String *text = writeText(o);
+
+	CHECK(strcmp(stringAsCString(expectedText), stringAsCString(text)) == 0);
+	deleteString(expectedText);
+	deleteString(text);
+
+	//Names from every thread are the ones in the parser's key table
+	const JSONKey *name = jsonInternKey(parallel, "name");
+	int otherNames = 0;
+
+	for (size_t i = 0; i < o->value.array.length; ++i) {
+		otherNames += jsonGetMemberName(o->value.array.items[i], 1, NULL) != name->name;
+	}
+	CHECK(otherNames == 0);
+	deleteString(data);
+
+	//An error in a later chunk has the line of the whole document
+	int broken = PARALLEL_ITEMS * 3 / 4;
+
+	data = parallelDocument(broken);
+	jsonParse(serial, data);
+	jsonParse(parallel, data);
+
+	CHECK(serial->errorCode == ERROR_SYNTAX);
+	CHECK(parallel->errorCode == ERROR_SYNTAX);
+	//errorLine counts the newlines before the error
+	CHECK(serial->errorLine == (size_t) broken + 1);
+	CHECK(parallel->errorLine == serial->errorLine);
+
+	deleteString(data);
+	deleteJSONParser(serial);
+	deleteJSONParser(parallel);
+}
+
+//Feeds data one byte at a time and compares the result with jsonParse()
+static void checkFeed(String *data) {
+	JSONParser *p = newJSONParser();
+	JSONParser *feed = newJSONParser();
+	JSONFeedStatus status = JSON_FEED_NEED_MORE;
+	String *expected = writeText(jsonParse(p, data));
+
+	jsonBeginFeed(feed);
+
+	for (size_t i = 0; i < data->length && status == JSON_FEED_NEED_MORE; ++i) {
+		status = jsonParserFeed(feed, data->buffer + i, 1);
+	}
+	if (status == JSON_FEED_NEED_MORE) {
+		status = jsonParserFeed(feed, NULL, 0);
+	}
+
+	CHECK(status == JSON_FEED_DONE);
+
+	if (status == JSON_FEED_DONE) {
+		String *text = writeText(feed->root);
+
+		CHECK(strcmp(stringAsCString(expected), stringAsCString(text)) == 0);
+		deleteString(text);
+	}
+
+	deleteString(expected);
+	deleteJSONParser(p);
+	deleteJSONParser(feed);
+}
+
+static void testFeed(const char *path) {
+	String *data = readFile(path);
+
+	checkFeed(data);
+	deleteString(data);
+
+	//Every piece is split inside a string, an escape, a number and a literal
+	data = newStringWithCString(
+		"{\"s\": \"a\\\"b\\\\c\\u00e9\\ud83d\\ude00\", "
+		"\"n\": -12.5e-3, \"t\": true, \"a\": [false, null, 1234567]}");
+	checkFeed(data);
+	deleteString(data);
+
+	JSONParser *p = newJSONParser();
+
+	jsonBeginFeed(p);
+	//An unfinished document fails at the end of input
+	CHECK(jsonParserFeed(p, "{\"a\": tr", 8) == JSON_FEED_NEED_MORE);
+	CHECK(jsonParserFeed(p, NULL, 0) == JSON_FEED_ERROR);
+	CHECK(p->errorCode == ERROR_SYNTAX);
+	deleteJSONParser(p);
+}
+
+typedef struct _TestAddress {
+	char street[8];
+	String *city;
+} TestAddress;
+
+typedef struct _TestOrder {
+	int64_t id;
+	int quantity;
+	double price;
+	bool active;
+	TestAddress address;
+	int fixed[3];
+	int fixedCount;
+	double *growable;
+	int growableCount;
+} TestOrder;
+
+static const JSONField addressFields[] = {
+	{"street", JSON_FIELD_CHARS, offsetof(TestAddress, street), 8},
+	{"city", JSON_FIELD_STRING, offsetof(TestAddress, city)}
+};
+static const JSONSchema addressSchema = {sizeof(TestAddress), addressFields, 2};
+
+static const JSONField orderFields[] = {
+	{"id", JSON_FIELD_INT64, offsetof(TestOrder, id)},
+	{"quantity", JSON_FIELD_INT, offsetof(TestOrder, quantity)},
+	{"price", JSON_FIELD_DOUBLE, offsetof(TestOrder, price)},
+	{"active", JSON_FIELD_BOOL, offsetof(TestOrder, active)},
+	{"address", JSON_FIELD_OBJECT, offsetof(TestOrder, address), 0, &addressSchema},
+	{"fixed", JSON_FIELD_ARRAY, offsetof(TestOrder, fixed), 3, NULL,
+		JSON_FIELD_INT, offsetof(TestOrder, fixedCount)},
+	{"growable", JSON_FIELD_ARRAY, offsetof(TestOrder, growable), 0, NULL,
+		JSON_FIELD_DOUBLE, offsetof(TestOrder, growableCount)}
+};
+static const JSONSchema orderSchema = {sizeof(TestOrder), orderFields, 7};
+
+//Binds text to a zeroed order and returns the error code
+static ErrorCode bindOrder(const char *text) {
+	JSONParser *p = newJSONParser();
+	TestOrder order = {0};
+
+	jsonBindCString(p, text, &orderSchema, &order);
+
+	ErrorCode code = p->errorCode;
+
+	jsonFreeBinding(&orderSchema, &order);
+	deleteJSONParser(p);
+
+	return code;
+}
+
+static void testBind() {
+	String *text = newStringWithCString(
+		"{\"id\": 9007199254740993, \"quantity\": -5, \"price\": 2.5, "
+		"\"active\": true, \"unknown\": [{\"id\": 1}], "
+		"\"address\": {\"street\": \"Main st\", \"city\": \"Paris\", \"zip\": 1}, "
+		"\"fixed\": [1, 2, 3], \"growable\": [");
+	char item[32];
+
+	//A growable array is reallocated many times
+	for (int i = 0; i < 1000; ++i) {
+		snprintf(item, sizeof(item), "%s%d.5", i > 0 ? ", " : "", i);
+		stringAppendCString(text, item);
+	}
+	stringAppendCString(text, "]}");
+
+	JSONParser *p = newJSONParser();
+	TestOrder order = {0};
+
+	CHECK(jsonBind(p, text, &orderSchema, &order));
+	CHECK(order.id == 9007199254740993LL);
+	CHECK(order.quantity == -5);
+	CHECK(order.price == 2.5);
+	CHECK(order.active);
+	CHECK(strcmp(order.address.street, "Main st") == 0);
+	CHECK(strcmp(stringAsCString(order.address.city), "Paris") == 0);
+	CHECK(order.fixedCount == 3 && order.fixed[2] == 3);
+	CHECK(order.growableCount == 1000 && order.growable[999] == 999.5);
+
+	jsonFreeBinding(&orderSchema, &order);
+	CHECK(order.growable == NULL && order.address.city == NULL);
+	deleteJSONParser(p);
+	deleteString(text);
+
+	//A char array needs room for the terminator
+	CHECK(bindOrder("{\"address\": {\"street\": \"Main st.\"}}") == ERROR_INVALID_TYPE);
+	CHECK(bindOrder("{\"fixed\": [1, 2, 3, 4]}") == ERROR_INVALID_TYPE);
+	CHECK(bindOrder("{\"quantity\": 2147483647}") == ERROR_NONE);
+	CHECK(bindOrder("{\"quantity\": 2147483648}") == ERROR_INVALID_TYPE);
+	CHECK(bindOrder("{\"quantity\": -2147483649}") == ERROR_INVALID_TYPE);
+	CHECK(bindOrder("{\"quantity\": 1.5}") == ERROR_INVALID_TYPE);
+	CHECK(bindOrder("{\"quantity\": \"1\"}") == ERROR_INVALID_TYPE);
+}
+
+//Returns the error code of parsing text with validateUTF8 set
+static ErrorCode parseValidated(const char *text) {
+	JSONParser *p = newJSONParser();
+
+	p->validateUTF8 = true;
+	jsonParseCString(p, text);
+
+	ErrorCode code = p->errorCode;
+
+	deleteJSONParser(p);
+
+	return code;
+}
+
+static void testUnicode() {
+	JSONParser *p = newJSONParser();
+	JSONObject *a = jsonParseCString(p,
+		"[\"\\ud83d\\ude00\", \"\\ud83dx\", \"\\ude00\", \"\\u00e9\\u20ac\"]");
+
+	CHECK(p->errorCode == ERROR_NONE);
+	CHECK(strcmp(jsonGetCStringAt(a, 0), "\xF0\x9F\x98\x80") == 0);
+	//A lone surrogate becomes U+FFFD
+	CHECK(strcmp(jsonGetCStringAt(a, 1), "\xEF\xBF\xBDx") == 0);
+	CHECK(strcmp(jsonGetCStringAt(a, 2), "\xEF\xBF\xBD") == 0);
+	CHECK(strcmp(jsonGetCStringAt(a, 3), "\xC3\xA9\xE2\x82\xAC") == 0);
+	deleteJSONParser(p);
+
+	CHECK(parseValidated("[\"\xC3\xA9\xF0\x9F\x98\x80\"]") == ERROR_NONE);
+	//A bad continuation byte, an overlong form, an encoded surrogate
+	//and a sequence cut short by the end of the string
+	CHECK(parseValidated("[\"\xC3\x28\"]") == ERROR_SYNTAX);
+	CHECK(parseValidated("[\"\xC0\xAF\"]") == ERROR_SYNTAX);
+	CHECK(parseValidated("[\"\xED\xA0\x80\"]") == ERROR_SYNTAX);
+	CHECK(parseValidated("[\"\xF0\x9F\x98\"]") == ERROR_SYNTAX);
+}
+
+static bool isLazy(JSONObject *o) {
+	return (o->flags & JSON_FLAG_LAZY) != 0;
+}
+
+static void testLazy(const char *path) {
+	String *data = readFile(path);
+	JSONParser *p = newJSONParser();
+	JSONParser *lazy = newJSONParser();
+	String *expected = writeText(jsonParse(p, data));
+	String *text = writeText(jsonParseLazy(lazy, data));
+
+	//Writing builds every container
+	CHECK(lazy->errorCode == ERROR_NONE);
+	CHECK(strcmp(stringAsCString(expected), stringAsCString(text)) == 0);
+	deleteString(expected);
+	deleteString(text);
+	deleteString(data);
+
+	data = newStringWithCString(
+		"{\"a\": [1, {\"b\": [2, \"]\"]}], \"c\": {\"d\": \"e\"}, \"x\": [1 2]}");
+
+	JSONObject *o = jsonParseLazy(lazy, data);
+	JSONObject *a = jsonGetArray(o, "a");
+	JSONObject *c = jsonGetObject(o, "c");
+
+	//Containers are built one at a time
+	CHECK(lazy->errorCode == ERROR_NONE);
+	CHECK(isLazy(a) && isLazy(c));
+	jsonExpand(a);
+	CHECK(!isLazy(a) && isLazy(c));
+	CHECK(jsonGetArrayLength(a) == 2);
+
+	//The containers inside a wait until they are read
+	JSONObject *inner = jsonGetObjectAt(a, 1);
+
+	CHECK(isLazy(inner));
+
+	JSONObject *b = jsonGetArray(inner, "b");
+
+	CHECK(!isLazy(inner) && isLazy(b));
+	CHECK(strcmp(jsonGetCStringAt(b, 1), "]") == 0);
+	CHECK(!isLazy(b));
+	CHECK(strcmp(jsonGetCString(c, "d"), "e") == 0);
+	CHECK(!isLazy(c));
+
+	//The error in x is found when it is built
+	jsonExpand(jsonGetArray(o, "x"));
+	CHECK(lazy->errorCode == ERROR_SYNTAX);
+
+	deleteString(data);
+	deleteJSONParser(p);
+	deleteJSONParser(lazy);
+}
+
+static void testInPlace() {
+	const char *text =
+		"{\"a\": \"x\\ty\\u00e9\\\"z\", \"b\": \"plain\", \"k\\u0041\": [\"end\"]}";
+	size_t length = strlen(text);
+	//Exactly the document, with no room for a terminator after it
+	char *buffer = malloc(length);
+
+	memcpy(buffer, text, length);
+
+	JSONParser *p = newJSONParser();
+	JSONObject *o = jsonParseInPlace(p, buffer, length);
+
+	CHECK(p->errorCode == ERROR_NONE);
+
+	//An escaped string shrinks where it was
+	const char *a = jsonGetCString(o, "a");
+
+	CHECK(a == buffer + 7);
+	CHECK(strcmp(a, "x\ty\xC3\xA9\"z") == 0);
+
+	//A string without escapes is terminated over its closing quote
+	size_t bLength;
+	const char *b = jsonGetStringView(o, "b", &bLength);
+
+	CHECK(b == strstr(text, "plain") - text + buffer);
+	CHECK(bLength == 5 && b[5] == '\0');
+	CHECK(strcmp(b, "plain") == 0);
+
+	//So are names, and a string that is followed by the end of an array
+	JSONObject *k = jsonGetArray(o, "kA");
+
+	CHECK(k != NULL && strcmp(jsonGetCStringAt(k, 0), "end") == 0);
+	CHECK(buffer[length - 3] == '\0');
+
+	deleteJSONParser(p);
+	free(buffer);
+}
+
 int main(int argc, char *argv[]) {
 	if (argc < 2) {
 		puts("Usage: test json_file");
 		return 1;
 	}
-	String *str = loadFile(argv[1]);
-	if (str == NULL) {
+	JSONParser *p = newJSONParser();
+	JSONObject *o = jsonParseFile(p, argv[1]);
+
+	if (p->errorCode == ERROR_IO) {
 		puts("Could not load input JSON file.");
 		return 2;
 	}
-
-	JSONParser *p = newJSONParser();
-	JSONObject *o = jsonParse(p, str);
-
 	if (p->errorCode != ERROR_NONE) {
-		printf("Parsing failed at line: %d. Message: %s\n",
+		printf("Parsing failed at line: %zu. Message: %s\n",
 			p->errorLine, p->errorMessage);
 		return 3;
 	}
@@ -49,7 +768,6 @@ int main(int argc, char *argv[]) {
 
 	JSONObject *a = jsonGetArray(o, "array");
 
-	String *s = jsonGetStringAt(a, 1);
 	printf("String is: %s\n",
 		stringAsCString(jsonGetStringAt(a, 1)));
 	printf("Bool is: %s\n",
@@ -62,7 +780,41 @@ int main(int argc, char *argv[]) {
 		jsonIsNullAt(a, 1) == true ? "true" : "false");
 
 	deleteJSONParser(p);
-	deleteString(str);
+
+	//Zero copy strings must stay valid after jsonParseCString()
+	p = newJSONParser();
+	p->zeroCopyStrings = true;
+	o = jsonParseCString(p, "{\"first-name\": \"Barry white\"}");
+
+	const char *name = jsonGetCString(o, "first-name");
+
+	if (name == NULL || strcmp(name, "Barry white") != 0) {
+		puts("Zero copy string was lost after jsonParseCString().");
+		return 4;
+	}
+	printf("Zero copy string is: %s\n", name);
+
+	deleteJSONParser(p);
+
+	testEscapes();
+	testNumbers();
+	testBinary();
+	testTokens();
+	testPaths();
+	testProjection();
+	testLines(true);
+	testLines(false);
+	testParallel();
+	testFeed(argv[1]);
+	testBind();
+	testUnicode();
+	testLazy(argv[1]);
+	testInPlace();
+
+	if (failures > 0) {
+		printf("%d checks failed.\n", failures);
+		return 5;
+	}
 
 	return 0;
 }